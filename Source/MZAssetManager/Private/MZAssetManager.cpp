@@ -77,7 +77,7 @@ void FMZAssetManager::SendList(const char* ListName, const TArray<FString>& Valu
 	if (!(MZClient && MZClient->IsConnected()))
 		return;
 
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<std::string> NameList;
 	for (const auto& name : Value)
 	{
@@ -87,6 +87,10 @@ void FMZAssetManager::SendList(const char* ListName, const TArray<FString>& Valu
 	auto offset = mz::app::CreateUpdateStringList(mb, mz::fb::CreateStringList(mb, mb.CreateString(ListName), mb.CreateVectorOfStrings(NameList)));
 	mb.Finish(offset);
 	auto buf = mb.Release();
+	if (!MZClient->OutboundDedup.ShouldSend(EMZOutboundKind::StringList, FAnsiStringView(ListName), buf.data(), buf.size()))
+	{
+		return;
+	}
 	auto root = flatbuffers::GetRoot<mz::app::UpdateStringList>(buf.data());
 	MZClient->AppServiceClient->UpdateStringList(*root);
 }
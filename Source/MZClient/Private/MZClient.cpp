@@ -2,6 +2,7 @@
 
 #include "MZClient.h"
 #include "MZCustomTimeStep.h"
+#include "MZLoopbackTransport.h"
 // std
 #include <cstdio>
 #include <string>
@@ -20,7 +21,6 @@
 #include "Engine/LocalPlayer.h"
 #include "GameFramework/GameModeBase.h"
 #include "GameFramework/GameStateBase.h"
-#include "Toolkits/FConsoleCommandExecutor.h"
 
 #define LOCTEXT_NAMESPACE "FMZClient"
 #pragma optimize("", off)
@@ -29,6 +29,20 @@ DEFINE_LOG_CATEGORY(LogMZClient);
 #define LOG(x) UE_LOG(LogMZClient, Display, TEXT(x))
 #define LOGF(x, y) UE_LOG(LogMZClient, Display, TEXT(x), y)
 
+DECLARE_STATS_GROUP(TEXT("MediaZ"), STATGROUP_MediaZ, STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued pin value tasks"), STAT_MZQueuedPinValueTasks, STATGROUP_MediaZ);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued function call tasks"), STAT_MZQueuedFunctionCallTasks, STATGROUP_MediaZ);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued tree update tasks"), STAT_MZQueuedTreeUpdateTasks, STATGROUP_MediaZ);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued console tasks"), STAT_MZQueuedConsoleTasks, STATGROUP_MediaZ);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Tasks carried over"), STAT_MZCarriedOverTasks, STATGROUP_MediaZ);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task queue overflows"), STAT_MZTaskQueueOverflows, STATGROUP_MediaZ);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task captures off the inline path"), STAT_MZTaskArenaAllocations, STATGROUP_MediaZ);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Task captures on the heap"), STAT_MZTaskHeapAllocations, STATGROUP_MediaZ);
+
+static TAutoConsoleVariable<int32> CVarNodeStatusMaxUpdatesPerSecond(TEXT("mediaz.NodeStatus.MaxUpdatesPerSecond"), 4, TEXT("Maximum number of node status updates sent to MediaZ per second, 0 means no limit"));
+static TAutoConsoleVariable<bool> CVarSharedPinMemory(TEXT("mediaz.SharedPinMemory"), false, TEXT("Creates a shared memory segment MediaZ can write pin values to instead of sending them over gRPC, read at startup"));
+static TAutoConsoleVariable<int32> CVarTaskBudgetUs(TEXT("mediaz.TaskBudgetUs"), 4000, TEXT("Time in microseconds the game thread may spend per frame on tasks coming from MediaZ. Pin values still run once it is spent unless they wait behind a tree update, console tasks only get what is left. 0 means no limit."));
+
 FGuid FMZClient::NodeId = {};
 FString FMZClient::AppKey = "";
 
@@ -119,6 +133,26 @@ TMap<FGuid, const mz::fb::Pin*> ParsePins(const mz::fb::Node* archive)
 	return re;
 }
 
+typedef TSharedPtr<flatbuffers::DetachedBuffer, ESPMode::ThreadSafe> FMZTableBuffer;
+
+//Tables given by the SDK only live during the callback, so they are packed into a standalone buffer once
+//on the gRPC thread and the game thread reads that buffer in place
+template <typename T>
+FMZTableBuffer CopyTable(T const& table)
+{
+	typename T::NativeTableType native;
+	table.UnPackTo(&native);
+	FMZFlatBufferBuilder fbb;
+	fbb.Finish(T::Pack(fbb, &native));
+	return MakeShared<flatbuffers::DetachedBuffer, ESPMode::ThreadSafe>(fbb.Release());
+}
+
+template <typename T>
+T const& GetTable(FMZTableBuffer const& buffer)
+{
+	return *flatbuffers::GetRoot<T>(buffer->data());
+}
+
 void MZEventDelegates::OnAppConnected(mz::fb::Node const* appNode)
 {
 	if (appNode)
@@ -132,27 +166,24 @@ void MZEventDelegates::OnAppConnected(mz::fb::Node const* appNode)
 	}
 
 	LOG("Connected to mzEngine");
+	//a new connection starts with nothing sent
+	PluginClient->OutboundDedup.Reset();
 	PluginClient->Connected();
 
-	mz::fb::TNode copy;
-	bool NodeIsPresent = false;
+	FMZTableBuffer copy;
 	if(appNode)
 	{
-		NodeIsPresent = true;
-		appNode->UnPackTo(&copy);
+		copy = CopyTable(*appNode);
 	}
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy, NodeIsPresent]()
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient, copy]()
 		{
-			if(!NodeIsPresent)
+			//connected without an app node
+			if(!copy)
 			{
 				MZClient->OnMZConnected.Broadcast(nullptr);
 				return;
 			}
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::fb::CreateNode(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			MZClient->OnMZConnected.Broadcast(flatbuffers::GetRoot<mz::fb::Node>(buf.data()));
+			MZClient->OnMZConnected.Broadcast(&GetTable<mz::fb::Node>(copy));
 		});
 
     
@@ -162,25 +193,25 @@ void MZEventDelegates::OnNodeUpdated(mz::fb::Node const& appNode)
 {
 	LOG("Node update from mediaz");
 
-	if (!PluginClient)
+	if (!PluginClient || PluginClient->IsLiveEventBlocked())
 	{
 		return;
 	}
+	if (PluginClient->SessionRecorder.IsRecording())
+	{
+		PluginClient->SessionRecorder.RecordNode(EMZRecordType::NodeUpdated, appNode);
+	}
+	PluginClient->OutboundDedup.Invalidate(EMZOutboundKind::NodeUpdate, *(FGuid*)appNode.id());
 	if (!FMZClient::NodeId.IsValid())
 	{
 		FMZClient::NodeId = *(FGuid*)appNode.id();
 		PluginClient->Connected();
 	}
 
-	mz::fb::TNode copy;
-	appNode.UnPackTo(&copy);
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy]()
+	FMZTableBuffer copy = CopyTable(appNode);
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient, copy]()
 		{
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::fb::CreateNode(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			MZClient->OnMZNodeUpdated.Broadcast(*flatbuffers::GetRoot<mz::fb::Node>(buf.data()));
+			MZClient->OnMZNodeUpdated.Broadcast(GetTable<mz::fb::Node>(copy));
 		});
 }
 
@@ -192,9 +223,14 @@ void MZEventDelegates::OnConnectionClosed()
 	{
 		return;
 	}
+	PluginClient->OutboundDedup.Reset();
 	PluginClient->Disconnected();
+	if (PluginClient->ConnectionManager)
+	{
+		PluginClient->ConnectionManager->NotifyConnectionClosed();
+	}
 	
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient]()
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient]()
 		{
 			MZClient->OnMZConnectionClosed.Broadcast();
 		});
@@ -229,7 +265,7 @@ void MZEventDelegates::OnConsoleCommand(mz::app::ConsoleCommand const* consoleCo
 		return;
 	}
 	FString CommandString = FString(consoleCommand->command()->c_str());
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, CommandString]()
+	PluginClient->EnqueueTask(EMZTaskClass::Console, [MZClient = PluginClient, CommandString]()
 		{
 			MZClient->ExecuteConsoleCommand(*CommandString);
 		});
@@ -248,25 +284,30 @@ void MZEventDelegates::OnConsoleAutoCompleteSuggestionRequest(
 		return;
 	}
 	FString InputString = FString(consoleAutoCompleteSuggestionRequest->input()->c_str());
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, InputString]()
+	PluginClient->EnqueueTask(EMZTaskClass::Console, [MZClient = PluginClient, InputString]()
 		{
-		    auto CmdExec = MakeUnique<FConsoleCommandExecutor>();
-		    //IModularFeatures::Get().RegisterModularFeature(IConsoleCommandExecutor::ModularFeatureName(), CmdExec.Get());
-		    TArray<FString> out; 
-			CmdExec->GetAutoCompleteSuggestions(*InputString, out);
-
-			flatbuffers::FlatBufferBuilder mb;
-			std::vector<flatbuffers::Offset<flatbuffers::String>> suggestions;
-
-			for(auto sugg : out)
+			//every page goes out as its own message so a single one stays small
+			int32 total = 0;
+			int32 first = 0;
+			do
 			{
-				suggestions.push_back(mb.CreateString(TCHAR_TO_UTF8(*sugg)));
-			}
-		    auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateConsoleAutoCompleteSuggestionsUpdateDirect(mb, &suggestions));
-		    mb.Finish(offset);
-		    auto buf = mb.Release();
-		    auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
-		    MZClient->AppServiceClient->Send(*root);
+				TArray<FString> out;
+				total = MZClient->ConsoleAutoComplete.GetSuggestions(InputString, out, first);
+				first += out.Num();
+
+				FMZFlatBufferBuilder mb;
+				std::vector<flatbuffers::Offset<flatbuffers::String>> suggestions;
+
+				for(auto sugg : out)
+				{
+					suggestions.push_back(mb.CreateString(TCHAR_TO_UTF8(*sugg)));
+				}
+				auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateConsoleAutoCompleteSuggestionsUpdateDirect(mb, &suggestions));
+				mb.Finish(offset);
+				auto buf = mb.Release();
+				auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
+				MZClient->AppServiceClient->Send(*root);
+			} while (first < total);
 		});
 }
 
@@ -282,7 +323,7 @@ void MZEventDelegates::OnLoadNodesOnPaths(mz::LoadNodesOnPaths const* loadNodesO
 	{
 		Paths.Push(path->c_str());
 	}
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, Paths]()
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient, Paths]()
 		{
 			MZClient->OnMZLoadNodesOnPaths.Broadcast(Paths);
 		});
@@ -311,7 +352,7 @@ void MZEventDelegates::OnNodeRemoved()
 		PluginClient->MZTimeStep->Step({ 1 , 50 });
 	}
 
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient]()
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient]()
 		{
 			FMZClient::NodeId = {};
 			MZClient->OnMZNodeRemoved.Broadcast();
@@ -320,21 +361,60 @@ void MZEventDelegates::OnNodeRemoved()
 
 void MZEventDelegates::OnPinValueChanged(mz::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset, uint32_t frameNumber)
 {
-	if (!PluginClient)
+	if (!PluginClient || PluginClient->IsLiveEventBlocked())
 	{
 		return;
 	}
-	PinDataQueues::OnPinValueChanged(pinId, data, size, reset, frameNumber);
+	if (PluginClient->SessionRecorder.IsRecording())
+	{
+		PluginClient->SessionRecorder.RecordPinValue(pinId, data, size, reset, frameNumber);
+	}
+	//the value MediaZ holds now is not the one last sent from here
+	PluginClient->OutboundDedup.Invalidate(EMZOutboundKind::PinValue, *(FGuid*)&pinId);
+	//one copy of the value is shared by the pin queue and the broadcast below
+	MZPinPayload payload(data, size);
+	bool frameOrdered = PushPinValue(pinId, payload, reset, frameNumber);
 	
-	std::vector<uint8_t> copy(size, 0);
-	memcpy(copy.data(), data, size);
 	FGuid id = *(FGuid*)&pinId;
 
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy, size, id, reset]()
+	if (reset || frameOrdered)
+	{
+		PluginClient->EnqueueTask(EMZTaskClass::PinValue, [MZClient = PluginClient, payload = MoveTemp(payload), id, reset]()
+			{
+				MZClient->OnMZPinValueChanged.Broadcast(*(mz::fb::UUID*)&id, payload.Data(), payload.Size(), reset);
+			});
+		return;
+	}
+
+	bool schedule = false;
+	{
+		std::scoped_lock<std::mutex> lock(MailboxGuard);
+		PinMailbox& mailbox = Mailboxes.FindOrAdd(id);
+		if (mailbox.Scheduled)
 		{
-			MZClient->OnMZPinValueChanged.Broadcast(*(mz::fb::UUID*)&id, copy.data(), size, reset);
-		});
+			CoalescedPinValues.fetch_add(1, std::memory_order_relaxed);
+		}
+		mailbox.Latest = MoveTemp(payload);
+		schedule = !mailbox.Scheduled;
+		mailbox.Scheduled = true;
+	}
 
+	if (schedule)
+	{
+		PluginClient->EnqueueTask(EMZTaskClass::PinValue, [MZClient = PluginClient, id]()
+			{
+				MZPinPayload latest = MZClient->EventDelegates->TakeLatestPinValue(id);
+				MZClient->OnMZPinValueChanged.Broadcast(*(mz::fb::UUID*)&id, latest.Data(), latest.Size(), false);
+			});
+	}
+}
+
+MZPinPayload MZEventDelegates::TakeLatestPinValue(FGuid const& pinId)
+{
+	std::scoped_lock<std::mutex> lock(MailboxGuard);
+	PinMailbox& mailbox = Mailboxes.FindOrAdd(pinId);
+	mailbox.Scheduled = false;
+	return MoveTemp(mailbox.Latest);
 }
 
 void MZEventDelegates::OnPinShowAsChanged(mz::fb::UUID const& pinId, mz::fb::ShowAs newShowAs)
@@ -347,7 +427,7 @@ void MZEventDelegates::OnPinShowAsChanged(mz::fb::UUID const& pinId, mz::fb::Sho
 	
 
 	FGuid id = *(FGuid*)&pinId;
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, id, newShowAs]()
+	PluginClient->EnqueueTask(EMZTaskClass::PinValue, [MZClient = PluginClient, id, newShowAs]()
 		{
 			MZClient->OnMZPinShowAsChanged.Broadcast(*(mz::fb::UUID*)&id, newShowAs);
 		});
@@ -356,32 +436,35 @@ void MZEventDelegates::OnPinShowAsChanged(mz::fb::UUID const& pinId, mz::fb::Sho
 void MZEventDelegates::OnFunctionCall(mz::fb::UUID const& nodeId, mz::fb::Node const& function)
 {
 	LOG("Function called from mediaz");
-	if (!PluginClient)
+	if (!PluginClient || PluginClient->IsLiveEventBlocked())
 	{
 		return;
 	}
+	if (PluginClient->SessionRecorder.IsRecording())
+	{
+		PluginClient->SessionRecorder.RecordFunctionCall(nodeId, function);
+	}
 
 
-	mz::fb::TNode copy;
-	function.UnPackTo(&copy);
+	FMZTableBuffer copy = CopyTable(function);
 	FGuid id = *(FGuid*)&nodeId;
 
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy, id]()
+	PluginClient->EnqueueTask(EMZTaskClass::FunctionCall, [MZClient = PluginClient, copy, id]()
 		{
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::fb::CreateNode(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			MZClient->OnMZFunctionCalled.Broadcast(*(mz::fb::UUID*)&id, *flatbuffers::GetRoot<mz::fb::Node>(buf.data()));
+			MZClient->OnMZFunctionCalled.Broadcast(*(mz::fb::UUID*)&id, GetTable<mz::fb::Node>(copy));
 		});
 }
 
 void MZEventDelegates::OnExecuteAppInfo(mz::app::AppExecuteInfo const* appExecuteInfo)
 {
-	if (!PluginClient)
+	if (!PluginClient || PluginClient->IsLiveEventBlocked())
 	{
 		return;
 	}
+	if (PluginClient->SessionRecorder.IsRecording())
+	{
+		PluginClient->SessionRecorder.RecordExecuteAppInfo(*appExecuteInfo);
+	}
 	
 	PluginClient->OnUpdatedNodeExecuted(*appExecuteInfo->delta_seconds());
 }
@@ -394,7 +477,7 @@ void MZEventDelegates::OnNodeSelected(mz::fb::UUID const& nodeId)
 		return;
 	}
 	FGuid id = *(FGuid*)&nodeId;
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, id]()
+	PluginClient->EnqueueTask(EMZTaskClass::FunctionCall, [MZClient = PluginClient, id]()
 		{
 			MZClient->OnMZNodeSelected.Broadcast(*(mz::fb::UUID*)&id);
 		});
@@ -409,15 +492,10 @@ void MZEventDelegates::OnContextMenuRequested(mz::ContextMenuRequest const& requ
 	}
 
 	
-	mz::TContextMenuRequest copy;
-	request.UnPackTo(&copy);
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy]()
+	FMZTableBuffer copy = CopyTable(request);
+	PluginClient->EnqueueTask(EMZTaskClass::FunctionCall, [MZClient = PluginClient, copy]()
 		{
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::CreateContextMenuRequest(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			MZClient->OnMZContextMenuRequested.Broadcast(*flatbuffers::GetRoot<mz::ContextMenuRequest>(buf.data()));
+			MZClient->OnMZContextMenuRequested.Broadcast(GetTable<mz::ContextMenuRequest>(copy));
 		});
 }
 
@@ -429,37 +507,32 @@ void MZEventDelegates::OnContextMenuCommandFired(mz::ContextMenuAction const& ac
 		return;
 	}
 
-	mz::TContextMenuAction copy;
-	action.UnPackTo(&copy);
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy]()
+	FMZTableBuffer copy = CopyTable(action);
+	PluginClient->EnqueueTask(EMZTaskClass::FunctionCall, [MZClient = PluginClient, copy]()
 		{
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::CreateContextMenuAction(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			MZClient->OnMZContextMenuCommandFired.Broadcast(*flatbuffers::GetRoot<mz::ContextMenuAction>(buf.data()));
+			MZClient->OnMZContextMenuCommandFired.Broadcast(GetTable<mz::ContextMenuAction>(copy));
 		});
 }
 
 void MZEventDelegates::OnNodeImported(mz::fb::Node const& appNode)
 {
 	LOG("Node imported from MediaZ");
-	if (!PluginClient)
+	if (!PluginClient || PluginClient->IsLiveEventBlocked())
 	{
 		return;
 	}
+	if (PluginClient->SessionRecorder.IsRecording())
+	{
+		PluginClient->SessionRecorder.RecordNode(EMZRecordType::NodeImported, appNode);
+	}
 
 
-	mz::fb::TNode copy;
-	appNode.UnPackTo(&copy);
-	PluginClient->TaskQueue.Enqueue([MZClient = PluginClient, copy]()
+	FMZTableBuffer copy = CopyTable(appNode);
+	PluginClient->EnqueueTask(EMZTaskClass::TreeUpdate, [MZClient = PluginClient, copy]()
 		{
-			flatbuffers::FlatBufferBuilder fbb;
-			auto offset = mz::fb::CreateNode(fbb, &copy);
-			fbb.Finish(offset);
-			auto buf = fbb.Release();
-			FMZClient::NodeId = *(FGuid*)&copy.id;
-			MZClient->OnMZNodeImported.Broadcast(*flatbuffers::GetRoot<mz::fb::Node>(buf.data()));
+			auto& node = GetTable<mz::fb::Node>(copy);
+			FMZClient::NodeId = *(FGuid*)node.id();
+			MZClient->OnMZNodeImported.Broadcast(node);
 
 			auto WorldContext = GEngine->GetWorldContextFromGameViewport(GEngine->GameViewport);
 			if (WorldContext->World())
@@ -476,14 +549,17 @@ FMZClient::FMZClient() {}
 
 bool FMZClient::IsConnected()
 {
-	return AppServiceClient && AppServiceClient->IsConnected();
+	//the connection thread's state is read directly so this stays valid off the game thread
+	return AppServiceClient && ConnectionManager && ConnectionManager->GetState() == EMZConnectionState::Connected;
 }
 
 void FMZClient::Connected()
 {
-	TaskQueue.Enqueue([&]()
+	EnqueueTask(EMZTaskClass::TreeUpdate, [&]()
 		{
 			LOG("Sent map information to MediaZ");
+			//MediaZ does not keep the statuses of a previous connection
+			UENodeStatusHandler.Invalidate();
 			auto WorldContext = GEngine->GetWorldContextFromGameViewport(GEngine->GameViewport);
 			if (WorldContext->World())
 			{
@@ -505,12 +581,12 @@ void FMZClient::Disconnected()
 
 void FMZClient::TryConnect()
 {
-	if (!IsWorldInitialized)
+	if (!IsWorldInitialized || !ConnectionManager)
 	{
 		return;
 	}
 
-	if (!AppServiceClient)
+	if (!ConnectionManager->IsStarted())
 	{
 		FString CmdAppKey;
 		if (FParse::Value(FCommandLine::Get(), TEXT("mzname"), CmdAppKey))
@@ -522,41 +598,28 @@ void FMZClient::TryConnect()
 		{
 			FMZClient::AppKey = "UE5";
 		}
-		auto ProjectPath = FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath());
-		auto ExePath = FString(FPlatformProcess::ExecutablePath());
-		AppServiceClient = FMediaZ::MakeAppServiceClient("localhost:50053", mz::app::ApplicationInfo {
-			.AppKey = TCHAR_TO_UTF8(*FMZClient::AppKey),
-			.AppName = "UE5"
-		});
 		EventDelegates = TSharedPtr<MZEventDelegates>(new MZEventDelegates());
 		EventDelegates->PluginClient = this;
 		UENodeStatusHandler.SetClient(this);
-		AppServiceClient->RegisterEventDelegates(EventDelegates.Get());
-		LOG("AppClient instance is created");
+		ConnectionManager->Start(EventDelegates.Get(), FMZClient::AppKey);
 	}
 
-	if (AppServiceClient)
+	if (ConnectionManager->GetState() != EMZConnectionState::Connected)
 	{
-		AppServiceClient->TryConnect();
+		return;
 	}
 
-	// (Samil) TODO: This connection logic should be provided by the SDK itself. 
-	// App developers should not be required implement 'always connect' behaviour.
-	//if (!Client->IsChannelReady)
-	//{
-	//	Client->IsChannelReady = (GRPC_CHANNEL_READY == Client->Connect());
-	//}
-
-	 if (!CustomTimeStepBound && IsConnected())
-	 {
-	 	MZTimeStep = NewObject<UMZCustomTimeStep>();
-	 	MZTimeStep->PluginClient = this;
-	 	if (GEngine->SetCustomTimeStep(MZTimeStep.Get()))
-	 	{
-	 		CustomTimeStepBound = true;
-	 	}
-	 }
-	return;
+	//the connection thread may have moved to another endpoint since the last tick
+	AppServiceClient = ConnectionManager->GetActiveClient();
+	if (!CustomTimeStepBound)
+	{
+		MZTimeStep = NewObject<UMZCustomTimeStep>();
+		MZTimeStep->PluginClient = this;
+		if (GEngine->SetCustomTimeStep(MZTimeStep.Get()))
+		{
+			CustomTimeStepBound = true;
+		}
+	}
 }
 
 void FMZClient::OnBeginFrame()
@@ -566,7 +629,7 @@ void FMZClient::OnBeginFrame()
 
 void FMZClient::OnPostWorldInit(UWorld* World, const UWorld::InitializationValues initValues)
 {
-	TaskQueue.Enqueue([World, this]()
+	EnqueueTask(EMZTaskClass::TreeUpdate, [World, this]()
 		{
 			auto WorldContext = GEngine->GetWorldContextFromGameViewport(GEngine->GameViewport);
 			if (World != WorldContext->World())
@@ -624,11 +687,22 @@ void FMZClient::StartupModule() {
 		return;
 	}
 
-	if (!FMediaZ::Initialize())
+	//the loopback transport stands in for MediaZ, the SDK is not needed
+	if (!FMZLoopbackTransport::IsRequested() && !FMediaZ::Initialize())
 	{
 		return;
 	}
 
+	ConsoleForwarder = MakeUnique<MZConsoleForwarder>(this);
+	ConsoleForwarder->Start();
+	ConsoleAutoComplete.Initialize();
+	ConnectionManager = MakeUnique<MZConnectionManager>();
+	SessionReplayer = MakeUnique<MZSessionReplayer>(this);
+	if (CVarSharedPinMemory.GetValueOnGameThread())
+	{
+		SharedPins.Create();
+	}
+
 	//Add Delegates
 	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FMZClient::Tick));
 	FWorldDelegates::OnPostWorldInitialization.AddRaw(this, &FMZClient::OnPostWorldInit);
@@ -639,10 +713,13 @@ void FMZClient::ShutdownModule()
 {
 	// AppServiceClient-/*>*/
 	MZTimeStep = nullptr;
-	if(FMediaZ::ShutdownClient)
-	{
-		FMediaZ::ShutdownClient(AppServiceClient);
-	}
+	ConsoleForwarder.Reset();
+	ConsoleAutoComplete.Shutdown();
+	SessionReplayer.Reset();
+	SessionRecorder.Stop();
+	SharedPins.Release();
+	AppServiceClient = nullptr;
+	ConnectionManager.Reset();
 	FMediaZ::Shutdown();
 }
 
@@ -655,15 +732,121 @@ bool FMZClient::Tick(float dt)
 	}
 	
     TryConnect();
-	while (!TaskQueue.IsEmpty() && ReloadingLevel <= 0) {
-		Task task;
-		TaskQueue.Dequeue(task);
-		task();
+	if (SessionReplayer && SessionReplayer->IsReplaying())
+	{
+		double DrainStart = FPlatformTime::Seconds();
+		DrainTaskQueues();
+		SessionReplayer->RecordFrameCost(FPlatformTime::Seconds() - DrainStart);
+	}
+	else
+	{
+		DrainTaskQueues();
+		if (SessionReplayer && SessionReplayer->IsFinished())
+		{
+			SessionReplayer->Shutdown();
+		}
+	}
+	FMZTaskArena::Get().ResetIfUnused();
+
+	FrameTimes.Record(dt);
+	double Now = FPlatformTime::Seconds();
+	if (Now - LastFrameTimeStatus >= 1.0)
+	{
+		//values are rounded so an unchanged distribution does not cause an update
+		UENodeStatusHandler.Add("frame_time", FrameTimes.GetNodeStatusMessage());
+		LastFrameTimeStatus = Now;
 	}
 	UENodeStatusHandler.Update();
 	return true;
 }
 
+void FMZClient::EnqueueTask(EMZTaskClass Class, FMZTask&& task)
+{
+	TaskQueueDepths[(int)Class].fetch_add(1, std::memory_order_relaxed);
+	if (Class == EMZTaskClass::Console)
+	{
+		LowPriorityTaskQueue.Enqueue({ MoveTemp(task), Class });
+		return;
+	}
+	TaskQueue.Enqueue({ MoveTemp(task), Class });
+}
+
+void FMZClient::DrainTaskQueues()
+{
+	int32 BudgetUs = CVarTaskBudgetUs.GetValueOnGameThread();
+	//only time spent on tasks other than pin values counts against the budget
+	double BudgetSpent = 0;
+	auto IsOverBudget = [&]() { return BudgetUs > 0 && BudgetSpent * 1e6 >= BudgetUs; };
+	auto Run = [&](FQueuedTask& Queued)
+		{
+			TaskQueueDepths[(int)Queued.Class].fetch_sub(1, std::memory_order_relaxed);
+			bool Budgeted = Queued.Class != EMZTaskClass::PinValue;
+			double Start = Budgeted ? FPlatformTime::Seconds() : 0;
+			Queued.Task();
+			if (Budgeted)
+			{
+				BudgetSpent += FPlatformTime::Seconds() - Start;
+			}
+		};
+
+	//what the budget held back last frame goes first, in its original order
+	while (!DeferredTasks.empty() && ReloadingLevel <= 0 && !IsOverBudget())
+	{
+		FQueuedTask Queued = MoveTemp(DeferredTasks.front());
+		DeferredTasks.pop_front();
+		Run(Queued);
+	}
+
+	//a held back tree update is a barrier, the pin values queued after it may refer to the pins it creates
+	bool TreeUpdateDeferred = std::any_of(DeferredTasks.begin(), DeferredTasks.end(), [](FQueuedTask const& Queued) { return Queued.Class == EMZTaskClass::TreeUpdate; });
+	FQueuedTask* Next;
+	while (ReloadingLevel <= 0 && !TreeUpdateDeferred && (Next = TaskQueue.Peek()) != nullptr)
+	{
+		FQueuedTask Queued = MoveTemp(*Next);
+		TaskQueue.Pop();
+		//once anything is held back the following budgeted tasks are too, so they keep their order
+		if (Queued.Class != EMZTaskClass::PinValue && (IsOverBudget() || !DeferredTasks.empty()))
+		{
+			TreeUpdateDeferred = Queued.Class == EMZTaskClass::TreeUpdate;
+			DeferredTasks.push_back(MoveTemp(Queued));
+			continue;
+		}
+		Run(Queued);
+	}
+
+	while (ReloadingLevel <= 0 && !IsOverBudget() && (Next = LowPriorityTaskQueue.Peek()) != nullptr)
+	{
+		FQueuedTask Queued = MoveTemp(*Next);
+		LowPriorityTaskQueue.Pop();
+		Run(Queued);
+	}
+
+	CarriedOverTasks = 0;
+	for (int Class = 0; Class < (int)EMZTaskClass::Count; ++Class)
+	{
+		CarriedOverTasks += TaskQueueDepths[Class].load(std::memory_order_relaxed);
+	}
+
+	SET_DWORD_STAT(STAT_MZQueuedPinValueTasks, TaskQueueDepths[(int)EMZTaskClass::PinValue].load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZQueuedFunctionCallTasks, TaskQueueDepths[(int)EMZTaskClass::FunctionCall].load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZQueuedTreeUpdateTasks, TaskQueueDepths[(int)EMZTaskClass::TreeUpdate].load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZQueuedConsoleTasks, TaskQueueDepths[(int)EMZTaskClass::Console].load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZCarriedOverTasks, CarriedOverTasks);
+	SET_DWORD_STAT(STAT_MZTaskQueueOverflows, TaskQueue.Overflows.load(std::memory_order_relaxed) + LowPriorityTaskQueue.Overflows.load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZTaskArenaAllocations, FMZTaskArena::Get().Allocations.load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_MZTaskHeapAllocations, FMZTaskArena::Get().HeapFallbacks.load(std::memory_order_relaxed));
+}
+
+bool FMZClient::IsLiveEventBlocked() const
+{
+	return SessionReplayer && SessionReplayer->BlocksLiveEvents();
+}
+
+FMZFrameClock const* FMZClient::GetFrameClock() const
+{
+	return MZTimeStep.IsValid() ? &MZTimeStep->GetFrameClock() : nullptr;
+}
+
 void FMZClient::OnUpdatedNodeExecuted(mz::fb::vec2u deltaSeconds)
 {
 	if (MZTimeStep.IsValid())
@@ -765,6 +948,11 @@ void UENodeStatusHandler::SetClient(FMZClient* _PluginClient)
 
 void UENodeStatusHandler::Add(std::string const& Id, mz::fb::TNodeStatusMessage const& Status)
 {
+	auto it = StatusMessages.find(Id);
+	if (it != StatusMessages.end() && it->second.text == Status.text && it->second.type == Status.type)
+	{
+		return;
+	}
 	StatusMessages[Id] = Status;
 	Dirty = true;
 }
@@ -781,17 +969,24 @@ void UENodeStatusHandler::Remove(std::string const& Id)
 
 void UENodeStatusHandler::Update()
 {
-	if (Dirty)
+	if (!Dirty)
 	{
-		SendStatus();
+		return;
+	}
+	double Now = FPlatformTime::Seconds();
+	int32 MaxUpdatesPerSecond = CVarNodeStatusMaxUpdatesPerSecond.GetValueOnGameThread();
+	if (MaxUpdatesPerSecond > 0 && Now - LastSendTime < 1.0 / MaxUpdatesPerSecond)
+	{
+		return;
 	}
+	SendStatus();
 }
 
 void UENodeStatusHandler::SendStatus()
 {
 	if (!PluginClient || !PluginClient->IsConnected() || !FMZClient::NodeId.IsValid())
 		return;
-	flatbuffers::FlatBufferBuilder Builder;
+	FMZFlatBufferBuilder Builder;
 	mz::TPartialNodeUpdate UpdateRequest;
 	UpdateRequest.node_id = *reinterpret_cast<mz::fb::UUID*>(&FMZClient::NodeId);
 	for (auto& [_, StatusMsg] : StatusMessages)
@@ -802,36 +997,54 @@ void UENodeStatusHandler::SendStatus()
 	Builder.Finish(offset);
 	auto buf = Builder.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	PluginClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	//queued behind the root node updates of this frame so it cannot overtake them
+	PluginClient->NodeUpdates.SendPartialNodeUpdate(*root);
 	Dirty = false;
+	LastSendTime = FPlatformTime::Seconds();
 }
 
-bool FPSCounter::Update(float dt)
+void FMZFrameTimeHistogram::Record(float DeltaSeconds)
 {
-	++FrameCount;
-	DeltaTimeAccum += dt;
-	if (DeltaTimeAccum >= 1.f)
+	Window[WindowPos].store(DeltaSeconds * 1e3f, std::memory_order_relaxed);
+	WindowPos = (WindowPos + 1) % WindowSize;
+	if (Count.load(std::memory_order_relaxed) < WindowSize)
+	{
+		Count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+FMZFrameTimeHistogram::FSummary FMZFrameTimeHistogram::GetSummary() const
+{
+	uint32 Total = Count.load(std::memory_order_relaxed);
+	if (Total == 0)
+	{
+		return {};
+	}
+	//the window is filled from the start, so the first Total samples are the recorded ones
+	TArray<float, TInlineAllocator<WindowSize>> Sorted;
+	Sorted.SetNumUninitialized(Total);
+	for (uint32 i = 0; i < Total; ++i)
 	{
-		auto Prev = FramesPerSecond;
-		FramesPerSecond = 1.f / (DeltaTimeAccum / float(FrameCount));
-		FramesPerSecond = std::roundf(FramesPerSecond  * 100.f) / 100.f;
-		DeltaTimeAccum = 0;
-		FrameCount = 0;
-		return Prev != FramesPerSecond;
+		Sorted[i] = Window[i].load(std::memory_order_relaxed);
 	}
-	return false;
+	Sorted.Sort();
+	//nearest rank
+	auto Percentile = [&Sorted, Total](float P) { return Sorted[FMath::Clamp<int32>(FMath::CeilToInt(P * Total), 1, int32(Total)) - 1]; };
+	return { .P50 = Percentile(0.5f), .P95 = Percentile(0.95f), .P99 = Percentile(0.99f), .Max = Sorted.Last() };
 }
 
-mz::fb::TNodeStatusMessage FPSCounter::GetNodeStatusMessage() const
+mz::fb::TNodeStatusMessage FMZFrameTimeHistogram::GetNodeStatusMessage() const
 {
-	mz::fb::TNodeStatusMessage FpsStatusMessage;
+	mz::fb::TNodeStatusMessage FrameTimeStatusMessage;
 
-	FpsStatusMessage.text.resize(32);
-	::snprintf(FpsStatusMessage.text.data(), 32, "%.2f FPS", FramesPerSecond);
-	FpsStatusMessage.text.shrink_to_fit();
+	FrameTimeStatusMessage.text.resize(96);
+	FSummary Summary = GetSummary();
+	int Length = ::snprintf(FrameTimeStatusMessage.text.data(), 96, "Frame ms p50 %.1f p95 %.1f p99 %.1f max %.1f",
+		Summary.P50, Summary.P95, Summary.P99, Summary.Max);
+	FrameTimeStatusMessage.text.resize(FMath::Clamp(Length, 0, 95));
 
-	FpsStatusMessage.type = mz::fb::NodeStatusMessageType::INFO;
-	return FpsStatusMessage;
+	FrameTimeStatusMessage.type = mz::fb::NodeStatusMessageType::INFO;
+	return FrameTimeStatusMessage;
 }
 
 #pragma optimize("", on)
@@ -0,0 +1,202 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZConnectionManager.h"
+#include "MZClient.h"
+#include "MZLoopbackTransport.h"
+#include "HAL/RunnableThread.h"
+
+static TAutoConsoleVariable<int32> CVarReconnectInitialDelayMs(TEXT("mediaz.Reconnect.InitialDelayMs"), 250, TEXT("Delay in milliseconds before the first retry of a failed connection attempt to MediaZ"));
+static TAutoConsoleVariable<int32> CVarReconnectMaxDelayMs(TEXT("mediaz.Reconnect.MaxDelayMs"), 5000, TEXT("Upper limit in milliseconds of the exponentially growing delay between connection attempts to MediaZ"));
+static TAutoConsoleVariable<int32> CVarReconnectPollIntervalMs(TEXT("mediaz.Reconnect.PollIntervalMs"), 500, TEXT("Interval in milliseconds an established connection to MediaZ is checked at"));
+
+MZConnectionManager::MZConnectionManager()
+	: JitterStream(FPlatformTime::Cycles())
+{
+}
+
+MZConnectionManager::~MZConnectionManager()
+{
+	Shutdown();
+}
+
+TArray<FString> MZConnectionManager::GetEndpoints()
+{
+	TArray<FString> Result;
+	FString CmdEndpoints;
+	if (FParse::Value(FCommandLine::Get(), TEXT("mzendpoints="), CmdEndpoints, false))
+	{
+		CmdEndpoints.ParseIntoArray(Result, TEXT(","));
+		for (auto& Endpoint : Result)
+		{
+			Endpoint.TrimStartAndEndInline();
+		}
+		Result.RemoveAll([](FString const& Endpoint) { return Endpoint.IsEmpty(); });
+	}
+	if (Result.IsEmpty())
+	{
+		Result.Add(TEXT("localhost:50053"));
+	}
+	return Result;
+}
+
+void MZConnectionManager::Start(mz::app::IEventDelegates* EventDelegates, FString const& AppKey)
+{
+	if (Thread)
+	{
+		return;
+	}
+
+	TArray<TUniquePtr<IMZTransport>> Transports;
+	TArray<FString> Names;
+	if (FMZLoopbackTransport::IsRequested())
+	{
+		Names = { TEXT("loopback") };
+		Transports.Add(MakeUnique<FMZLoopbackTransport>());
+	}
+	else
+	{
+		Names = GetEndpoints();
+		for (auto& Endpoint : Names)
+		{
+			Transports.Add(MakeUnique<FMZSDKTransport>(Endpoint, AppKey));
+		}
+	}
+	for (int32 i = 0; i < Transports.Num(); ++i)
+	{
+		Transports[i]->RegisterEventDelegates(EventDelegates);
+		UE_LOG(LogMZClient, Display, TEXT("AppClient instance is created for %s"), *Names[i]);
+	}
+	Start(MoveTemp(Transports), Names);
+}
+
+void MZConnectionManager::Start(TArray<TUniquePtr<IMZTransport>>&& Transports, TArray<FString> const& Names)
+{
+	if (Thread || Transports.IsEmpty())
+	{
+		return;
+	}
+	check(Transports.Num() == Names.Num());
+	Clients = MoveTemp(Transports);
+	Endpoints = Names;
+
+	bExit = false;
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("MZConnectionThread"), 0, TPri_BelowNormal);
+}
+
+void MZConnectionManager::Shutdown()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+
+	ActiveClient = nullptr;
+	State = EMZConnectionState::Disconnected;
+	Clients.Empty();
+}
+
+void MZConnectionManager::Stop()
+{
+	bExit = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void MZConnectionManager::SetSuspended(bool bInSuspended)
+{
+	bSuspended = bInSuspended;
+	if (!bInSuspended && WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void MZConnectionManager::NotifyConnectionClosed()
+{
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+uint32 MZConnectionManager::Run()
+{
+	uint32 EndpointIndex = 0;
+	uint32 FailedAttempts = 0;
+	while (!bExit)
+	{
+		if (bSuspended)
+		{
+			State.store(EMZConnectionState::Disconnected, std::memory_order_release);
+			WakeEvent->Wait(FMath::Max(CVarReconnectPollIntervalMs.GetValueOnAnyThread(), 1));
+			continue;
+		}
+		if (ConnectAndWait(EndpointIndex))
+		{
+			//stay on the endpoint that worked, a dropped connection starts a fresh backoff sequence
+			FailedAttempts = 0;
+		}
+		else
+		{
+			++FailedAttempts;
+			EndpointIndex = (EndpointIndex + 1) % Clients.Num();
+		}
+
+		if (bExit)
+		{
+			break;
+		}
+		State.store(EMZConnectionState::Backoff, std::memory_order_release);
+		WaitBackoff(FailedAttempts);
+	}
+	State.store(EMZConnectionState::Disconnected, std::memory_order_release);
+	return 0;
+}
+
+bool MZConnectionManager::ConnectAndWait(uint32 EndpointIndex)
+{
+	auto Client = Clients[EndpointIndex].Get();
+	State.store(EMZConnectionState::Connecting, std::memory_order_release);
+	ConnectAttempts.fetch_add(1, std::memory_order_relaxed);
+	Client->TryConnect();
+	if (!Client->IsConnected())
+	{
+		return false;
+	}
+
+	UE_LOG(LogMZClient, Display, TEXT("Connected to MediaZ at %s"), *Endpoints[EndpointIndex]);
+	ActiveClient.store(Client, std::memory_order_release);
+	State.store(EMZConnectionState::Connected, std::memory_order_release);
+	while (!bExit && Client->IsConnected())
+	{
+		WakeEvent->Wait(FMath::Max(CVarReconnectPollIntervalMs.GetValueOnAnyThread(), 1));
+	}
+	if (!bExit)
+	{
+		UE_LOG(LogMZClient, Display, TEXT("Connection to MediaZ at %s is lost"), *Endpoints[EndpointIndex]);
+	}
+	return true;
+}
+
+void MZConnectionManager::WaitBackoff(uint32 FailedAttempts)
+{
+	WakeEvent->Wait((uint32)GetBackoffDelayMs(FailedAttempts, Clients.Num(), JitterStream));
+}
+
+int64 MZConnectionManager::GetBackoffDelayMs(uint32 FailedAttempts, int32 EndpointCount, FRandomStream& Jitter)
+{
+	int32 InitialDelayMs = FMath::Max(CVarReconnectInitialDelayMs.GetValueOnAnyThread(), 1);
+	int32 MaxDelayMs = FMath::Max(CVarReconnectMaxDelayMs.GetValueOnAnyThread(), InitialDelayMs);
+	//only back off once every endpoint failed in a row
+	uint32 Rounds = FailedAttempts / FMath::Max(EndpointCount, 1);
+	int64 DelayMs = FMath::Min<int64>((int64)InitialDelayMs << FMath::Min<uint32>(Rounds, 20), MaxDelayMs);
+	//jitter keeps several instances from retrying against a restarted MediaZ in lockstep
+	return DelayMs / 2 + Jitter.RandRange(0, (int32)(DelayMs / 2));
+}
@@ -0,0 +1,166 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZConsoleAutoComplete.h"
+#include "Modules/ModuleManager.h"
+
+static TAutoConsoleVariable<int32> CVarAutoCompletePageSize(TEXT("mediaz.AutoComplete.PageSize"), 100, TEXT("Maximum number of console autocomplete suggestions sent to MediaZ per message, larger results are sent in several messages"));
+
+namespace
+{
+	//Console objects can also be registered and unregistered at any time after their module was loaded, e.g. from scripts.
+	//Engines that report it let the index be rebuilt right away, the others fall back to rebuilding on lookups that miss.
+	template <typename ManagerType>
+	FDelegateHandle AddConsoleObjectRegisteredHandler(ManagerType& Manager, TFunction<void()> Handler)
+	{
+		if constexpr (requires { Manager.OnConsoleObjectRegistered(); })
+		{
+			return Manager.OnConsoleObjectRegistered().AddLambda([Handler](auto&&...) { Handler(); });
+		}
+		return FDelegateHandle();
+	}
+
+	template <typename ManagerType>
+	void RemoveConsoleObjectRegisteredHandler(ManagerType& Manager, FDelegateHandle Handle)
+	{
+		if constexpr (requires { Manager.OnConsoleObjectRegistered(); })
+		{
+			Manager.OnConsoleObjectRegistered().Remove(Handle);
+		}
+	}
+
+	template <typename ManagerType>
+	FDelegateHandle AddConsoleObjectUnregisteredHandler(ManagerType& Manager, TFunction<void()> Handler)
+	{
+		if constexpr (requires { Manager.OnConsoleObjectUnregistered(); })
+		{
+			return Manager.OnConsoleObjectUnregistered().AddLambda([Handler](auto&&...) { Handler(); });
+		}
+		return FDelegateHandle();
+	}
+
+	template <typename ManagerType>
+	void RemoveConsoleObjectUnregisteredHandler(ManagerType& Manager, FDelegateHandle Handle)
+	{
+		if constexpr (requires { Manager.OnConsoleObjectUnregistered(); })
+		{
+			Manager.OnConsoleObjectUnregistered().Remove(Handle);
+		}
+	}
+
+	//Lookups that miss rebuild the index at most this often, so typing an unknown name does not rebuild on every key
+	constexpr double MissRebuildIntervalSeconds = 1.0;
+}
+
+void MZConsoleAutoComplete::Initialize()
+{
+	//modules register their console objects when they are loaded
+	ModulesChangedHandle = FModuleManager::Get().OnModulesChanged().AddLambda([this](FName, EModuleChangeReason)
+		{
+			MarkDirty();
+		});
+	ConsoleObjectRegisteredHandle = AddConsoleObjectRegisteredHandler(IConsoleManager::Get(), [this]() { MarkDirty(); });
+	ConsoleObjectUnregisteredHandle = AddConsoleObjectUnregisteredHandler(IConsoleManager::Get(), [this]() { MarkDirty(); });
+}
+
+void MZConsoleAutoComplete::Shutdown()
+{
+	FModuleManager::Get().OnModulesChanged().Remove(ModulesChangedHandle);
+	RemoveConsoleObjectRegisteredHandler(IConsoleManager::Get(), ConsoleObjectRegisteredHandle);
+	RemoveConsoleObjectUnregisteredHandler(IConsoleManager::Get(), ConsoleObjectUnregisteredHandle);
+	Names.Empty();
+	Nodes.Empty();
+	bDirty = true;
+}
+
+int32 MZConsoleAutoComplete::FindChild(int32 NodeIndex, TCHAR Char) const
+{
+	for (auto& [ChildChar, ChildIndex] : Nodes[NodeIndex].Children)
+	{
+		if (ChildChar == Char)
+		{
+			return ChildIndex;
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 MZConsoleAutoComplete::FindNode(const FString& Input) const
+{
+	int32 NodeIndex = 0;
+	for (TCHAR Char : Input)
+	{
+		NodeIndex = FindChild(NodeIndex, FChar::ToLower(Char));
+		if (NodeIndex == INDEX_NONE)
+		{
+			break;
+		}
+	}
+	return NodeIndex;
+}
+
+void MZConsoleAutoComplete::Rebuild()
+{
+	//cleared first so objects registered while the names are collected mark it again
+	bDirty = false;
+	LastRebuildTime = FPlatformTime::Seconds();
+	Names.Reset();
+	IConsoleManager::Get().ForEachConsoleObjectThatStartsWith(FConsoleObjectVisitor::CreateLambda([this](const TCHAR* Name, IConsoleObject* Object)
+		{
+			if (!Object->TestFlags(ECVF_Unregistered))
+			{
+				Names.Add(Name);
+			}
+		}), TEXT(""));
+	Names.Sort([](const FString& A, const FString& B) { return A.Compare(B, ESearchCase::IgnoreCase) < 0; });
+
+	Nodes.Reset();
+	Nodes.AddDefaulted();
+	Nodes[0].End = Names.Num();
+	for (int32 NameIndex = 0; NameIndex < Names.Num(); ++NameIndex)
+	{
+		int32 NodeIndex = 0;
+		for (TCHAR Char : Names[NameIndex])
+		{
+			Char = FChar::ToLower(Char);
+			int32 Child = FindChild(NodeIndex, Char);
+			if (Child == INDEX_NONE)
+			{
+				Child = Nodes.AddDefaulted();
+				Nodes[Child].Begin = NameIndex;
+				Nodes[NodeIndex].Children.Add({ Char, Child });
+			}
+			//names are sorted so every prefix covers a contiguous range
+			Nodes[Child].End = NameIndex + 1;
+			NodeIndex = Child;
+		}
+	}
+}
+
+int32 MZConsoleAutoComplete::GetSuggestions(const FString& Input, TArray<FString>& Out, int32 First)
+{
+	if (bDirty)
+	{
+		Rebuild();
+	}
+
+	int32 NodeIndex = FindNode(Input);
+	if (NodeIndex == INDEX_NONE && FPlatformTime::Seconds() - LastRebuildTime > MissRebuildIntervalSeconds)
+	{
+		Rebuild();
+		NodeIndex = FindNode(Input);
+	}
+	if (NodeIndex == INDEX_NONE)
+	{
+		return 0;
+	}
+
+	FNode const& Node = Nodes[NodeIndex];
+	int32 Begin = Node.Begin + FMath::Max(First, 0);
+	int32 End = FMath::Min(Node.End, Begin + FMath::Max(CVarAutoCompletePageSize.GetValueOnGameThread(), 1));
+	Out.Reserve(Out.Num() + FMath::Max(End - Begin, 0));
+	for (int32 i = Begin; i < End; ++i)
+	{
+		Out.Add(Names[i]);
+	}
+	return Node.End - Node.Begin;
+}
@@ -0,0 +1,219 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZConsoleForwarder.h"
+#include "MZClient.h"
+#include "HAL/RunnableThread.h"
+
+static TAutoConsoleVariable<int32> CVarConsoleForwardFlushIntervalMs(TEXT("mediaz.ConsoleForward.FlushIntervalMs"), 50, TEXT("Interval in milliseconds console output is batched for before it is sent to MediaZ"));
+static TAutoConsoleVariable<int32> CVarConsoleForwardMaxLinesPerSecond(TEXT("mediaz.ConsoleForward.MaxLinesPerSecond"), 200, TEXT("Maximum number of console lines per log category forwarded to MediaZ each second, 0 means no limit"));
+
+static constexpr size_t MaxBatchSize = 64 * 1024;
+
+MZConsoleForwarder::MZConsoleForwarder(FMZClient* InMZClient)
+	: MZClient(InMZClient)
+	, Slots(std::make_unique<FSlot[]>(Capacity))
+{
+	for (uint32 i = 0; i < Capacity; ++i)
+	{
+		Slots[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+	Batch.reserve(MaxBatchSize);
+}
+
+MZConsoleForwarder::~MZConsoleForwarder()
+{
+	Shutdown();
+}
+
+void MZConsoleForwarder::Start()
+{
+	if (Thread)
+	{
+		return;
+	}
+	bExit = false;
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("MZConsoleForwarderThread"), 0, TPri_BelowNormal);
+}
+
+void MZConsoleForwarder::Shutdown()
+{
+	if (!Thread)
+	{
+		return;
+	}
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+void MZConsoleForwarder::Stop()
+{
+	bExit = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+bool MZConsoleForwarder::Append(const TCHAR* Line, const FName& Category)
+{
+	if (!Line || !*Line)
+	{
+		return false;
+	}
+
+	if (!PassesRateLimit(Category))
+	{
+		DroppedLines.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	FTCHARToUTF8 Utf8(Line);
+	uint32 Length = uint32(Utf8.Length());
+	if (Length > MaxLineLength)
+	{
+		//cut before the sequence the limit falls into, continuation bytes look like 10xxxxxx
+		Length = MaxLineLength;
+		while (Length > 0 && (uint8(Utf8.Get()[Length]) & 0xC0) == 0x80)
+		{
+			--Length;
+		}
+	}
+	if (!TryPush(Utf8.Get(), Length))
+	{
+		DroppedLines.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+bool MZConsoleForwarder::PassesRateLimit(const FName& Category)
+{
+	int32 MaxLinesPerSecond = CVarConsoleForwardMaxLinesPerSecond.GetValueOnAnyThread();
+	if (MaxLinesPerSecond <= 0)
+	{
+		return true;
+	}
+
+	//categories sharing a bucket share the limit, which is fine for a safety valve
+	FRateBucket& Bucket = RateBuckets[GetTypeHash(Category) % RateBucketCount];
+	uint32 Now = uint32(FPlatformTime::Seconds());
+	uint32 Second = Bucket.Second.load(std::memory_order_relaxed);
+	if (Second != Now && Bucket.Second.compare_exchange_strong(Second, Now, std::memory_order_relaxed))
+	{
+		Bucket.Count.store(0, std::memory_order_relaxed);
+	}
+	return Bucket.Count.fetch_add(1, std::memory_order_relaxed) < uint32(MaxLinesPerSecond);
+}
+
+bool MZConsoleForwarder::TryPush(const char* Text, uint32 Length)
+{
+	uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		FSlot& Slot = Slots[Pos % Capacity];
+		uint64 Sequence = Slot.Sequence.load(std::memory_order_acquire);
+		int64 Diff = int64(Sequence) - int64(Pos);
+		if (Diff == 0)
+		{
+			if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				FMemory::Memcpy(Slot.Text, Text, Length);
+				Slot.Length = Length;
+				Slot.Sequence.store(Pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			Pos = EnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool MZConsoleForwarder::TryPop(std::string& Out)
+{
+	uint64 Pos = DequeuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		FSlot& Slot = Slots[Pos % Capacity];
+		uint64 Sequence = Slot.Sequence.load(std::memory_order_acquire);
+		int64 Diff = int64(Sequence) - int64(Pos + 1);
+		if (Diff == 0)
+		{
+			if (DequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				if (!Out.empty())
+				{
+					Out.push_back('\n');
+				}
+				Out.append(Slot.Text, Slot.Length);
+				Slot.Sequence.store(Pos + Capacity, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			Pos = DequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void MZConsoleForwarder::Flush()
+{
+	bool bConnected = MZClient && MZClient->IsConnected();
+	for (;;)
+	{
+		Batch.clear();
+		while (Batch.size() < MaxBatchSize && TryPop(Batch))
+		{
+		}
+
+		uint64 Dropped = DroppedLines.exchange(0, std::memory_order_relaxed);
+		if (Dropped)
+		{
+			if (!Batch.empty())
+			{
+				Batch.push_back('\n');
+			}
+			Batch += "[" + std::to_string(Dropped) + " console lines dropped]";
+		}
+
+		if (Batch.empty())
+		{
+			return;
+		}
+
+		if (bConnected)
+		{
+			FMZFlatBufferBuilder mb;
+			auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateConsoleOutputDirect(mb, Batch.c_str()));
+			mb.Finish(offset);
+			auto buf = mb.Release();
+			auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
+			MZClient->AppServiceClient->Send(*root);
+		}
+	}
+}
+
+uint32 MZConsoleForwarder::Run()
+{
+	while (!bExit)
+	{
+		WakeEvent->Wait(FMath::Max(CVarConsoleForwardFlushIntervalMs.GetValueOnAnyThread(), 1));
+		Flush();
+	}
+	Flush();
+	return 0;
+}
@@ -0,0 +1,161 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZCustomTimeStep.h"
+#include <chrono>
+
+static TAutoConsoleVariable<bool> CVarFrameLock(TEXT("mediaz.FrameLock"), true, TEXT("Waits for MediaZ to step each frame while connected instead of free running"));
+static TAutoConsoleVariable<int32> CVarFrameLockTimeoutMs(TEXT("mediaz.FrameLock.TimeoutMs"), 100, TEXT("Time in milliseconds a frame waits for the step signal of MediaZ before the engine falls back to free running"));
+static TAutoConsoleVariable<int32> CVarFrameLockSpinUs(TEXT("mediaz.FrameLock.SpinUs"), 200, TEXT("Time in microseconds to spin for the step signal before blocking"));
+static TAutoConsoleVariable<int32> CVarFrameLockWakeMarginUs(TEXT("mediaz.FrameLock.WakeMarginUs"), 1000, TEXT("Blocking wait ends this many microseconds before the timeout and the rest is spun, covers the sleep granularity of the OS"));
+
+static FAutoConsoleCommandWithOutputDevice FrameLockStatsCommand(
+	TEXT("mediaz.FrameLockStats"),
+	TEXT("Prints the wait time, overshoot and drift of the frames locked to MediaZ."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			FMZClient* Client = FModuleManager::GetModulePtr<FMZClient>("MZClient");
+			if (Client && Client->MZTimeStep.IsValid())
+			{
+				Client->MZTimeStep->DumpStats(Ar);
+			}
+		}));
+
+void UMZCustomTimeStep::Step(mz::fb::vec2u deltaSeconds)
+{
+	std::unique_lock lock(Mutex);
+	if (deltaSeconds.x() != 0 && deltaSeconds.y() != 0)
+	{
+		StepNumerator = deltaSeconds.x();
+		StepDenominator = deltaSeconds.y();
+	}
+	SignalTime.store(FPlatformTime::Seconds(), std::memory_order_relaxed);
+	PendingSteps.fetch_add(1, std::memory_order_release);
+	bool Notify = IsWaiting;
+	lock.unlock();
+	if (Notify)
+	{
+		CV.notify_one();
+	}
+}
+
+bool UMZCustomTimeStep::UpdateTimeStep(class UEngine* InEngine)
+{
+	if (!PluginClient || !PluginClient->IsConnected() || !CVarFrameLock.GetValueOnGameThread())
+	{
+		FrameLocked = true;
+		LockStartSeconds = 0;
+		return true;
+	}
+
+	if (!FrameLocked)
+	{
+		//free running since a step timed out, lock again once MediaZ steps
+		if (!PendingSteps.load(std::memory_order_acquire))
+		{
+			return true;
+		}
+		FrameLocked = true;
+		LockStartSeconds = 0;
+		PluginClient->UENodeStatusHandler.Remove("frame_lock");
+		UE_LOG(LogMZClient, Display, TEXT("Frame lock to MediaZ is established again."));
+	}
+
+	double WaitStart = FPlatformTime::Seconds();
+	bool TimedOut = !WaitForStep(WaitStart + CVarFrameLockTimeoutMs.GetValueOnGameThread() * 1e-3);
+	double WaitEnd = FPlatformTime::Seconds();
+	RecordFrame(WaitStart, WaitEnd, TimedOut);
+
+	if (TimedOut)
+	{
+		FrameLocked = false;
+		++Timeouts;
+		UE_LOG(LogMZClient, Warning, TEXT("MediaZ did not step the frame in %d ms, free running until the next step."), CVarFrameLockTimeoutMs.GetValueOnGameThread());
+		mz::fb::TNodeStatusMessage FrameLockStatus;
+		FrameLockStatus.text = "Frame lock timed out, free running";
+		FrameLockStatus.type = mz::fb::NodeStatusMessageType::WARNING;
+		PluginClient->UENodeStatusHandler.Add("frame_lock", FrameLockStatus);
+		return true;
+	}
+
+	uint32 Steps = PendingSteps.exchange(0, std::memory_order_acquire);
+	uint32 Numerator, Denominator;
+	{
+		std::unique_lock lock(Mutex);
+		Numerator = StepNumerator;
+		Denominator = StepDenominator;
+	}
+
+	bool LockStarted = LockStartSeconds == 0;
+	if (LockStarted)
+	{
+		//continue from the time the engine reached while free running, steps that piled up meanwhile are already covered by it
+		Clock.Rebase(FMath::IsNearlyZero(FApp::GetLastTime()) ? FPlatformTime::Seconds() - 0.0001 : FApp::GetLastTime());
+		Steps = 1;
+	}
+	//a frame that took longer than MediaZ's step covers every step signaled meanwhile, so engine time keeps up with MediaZ
+	CaughtUpSteps += Steps - 1;
+	Clock.SetFrameDuration(Numerator, Denominator);
+	Clock.Advance(Steps);
+
+	FApp::SetCurrentTime(Clock.GetSeconds());
+	FApp::UpdateLastTime();
+	FApp::SetDeltaTime(Clock.GetFrameDuration() * Steps);
+
+	if (LockStarted)
+	{
+		LockStartSeconds = WaitEnd;
+		LockStartAppTime = FApp::GetCurrentTime();
+	}
+	DriftMs = ((FApp::GetCurrentTime() - LockStartAppTime) - (WaitEnd - LockStartSeconds)) * 1e3;
+	++LockedFrames;
+	return false;
+}
+
+bool UMZCustomTimeStep::WaitForStep(double Deadline)
+{
+	double SpinUntil = FPlatformTime::Seconds() + CVarFrameLockSpinUs.GetValueOnGameThread() * 1e-6;
+	double WakeMargin = CVarFrameLockWakeMarginUs.GetValueOnGameThread() * 1e-6;
+	while (!PendingSteps.load(std::memory_order_acquire))
+	{
+		double Now = FPlatformTime::Seconds();
+		if (Now >= Deadline)
+		{
+			return false;
+		}
+		if (Now < SpinUntil || Deadline - Now <= WakeMargin)
+		{
+			FPlatformProcess::Yield();
+			continue;
+		}
+
+		std::unique_lock lock(Mutex);
+		IsWaiting = true;
+		CV.wait_for(lock, std::chrono::duration<double>(Deadline - WakeMargin - Now), [this] { return PendingSteps.load(std::memory_order_acquire) != 0; });
+		IsWaiting = false;
+	}
+	return true;
+}
+
+void UMZCustomTimeStep::RecordFrame(double WaitStart, double WaitEnd, bool TimedOut)
+{
+	LastWaitMs = (WaitEnd - WaitStart) * 1e3;
+	WaitTimes.Record(WaitEnd - WaitStart);
+	if (!TimedOut)
+	{
+		//time between the step signal and the game thread running again, zero if the signal was already there
+		double Overshoot = FMath::Max(0., WaitEnd - FMath::Max(SignalTime.load(std::memory_order_relaxed), WaitStart));
+		LastOvershootMs = Overshoot * 1e3;
+		Overshoots.Record(Overshoot);
+	}
+}
+
+void UMZCustomTimeStep::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("Frame lock %s, %llu locked frames, %llu timeouts, %llu steps caught up"), FrameLocked ? TEXT("active") : TEXT("free running"), LockedFrames, Timeouts, CaughtUpSteps);
+	FMZFrameTimeHistogram::FSummary Wait = WaitTimes.GetSummary();
+	FMZFrameTimeHistogram::FSummary Overshoot = Overshoots.GetSummary();
+	Ar.Logf(TEXT("Wait ms last %.3f p50 %.3f p99 %.3f max %.3f"), LastWaitMs, Wait.P50, Wait.P99, Wait.Max);
+	Ar.Logf(TEXT("Overshoot ms last %.3f p50 %.3f p99 %.3f max %.3f"), LastOvershootMs, Overshoot.P50, Overshoot.P99, Overshoot.Max);
+	Ar.Logf(TEXT("Drift ms %.3f"), DriftMs);
+	Ar.Logf(TEXT("Frame %llu at %s fps, timecode %s"), Clock.GetFrameIndex(), *Clock.GetFrameRate().ToPrettyText().ToString(), *Clock.GetTimecode().ToString());
+}
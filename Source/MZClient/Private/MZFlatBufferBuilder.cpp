@@ -0,0 +1,111 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZFlatBufferBuilder.h"
+
+//Each buffer is preceded by its capacity, flatbuffers only tells the size it asked for when freeing
+static constexpr size_t BlockHeaderSize = 16;
+static constexpr uint32 MaxCachedBlocks = 8;
+//Larger buffers are rare, caching them would only pin memory
+static constexpr size_t MaxCachedBlockSize = 4 << 20;
+
+static FAutoConsoleCommandWithOutputDevice FlatBufferPoolStatsCommand(
+	TEXT("mediaz.FlatBufferPoolStats"),
+	TEXT("Prints how many outbound message buffers were reused and how many were allocated from the heap."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			auto& Allocator = FMZFlatBufferAllocator::Get();
+			Ar.Logf(TEXT("Flatbuffer allocations: %llu pooled, %llu heap"), Allocator.PooledAllocations.load(), Allocator.HeapAllocations.load());
+		}));
+
+namespace
+{
+	struct FBlockCache
+	{
+		uint8* Blocks[MaxCachedBlocks] = {};
+		uint32 Count = 0;
+
+		~FBlockCache()
+		{
+			for (uint32 i = 0; i < Count; ++i)
+			{
+				FMemory::Free(Blocks[i]);
+			}
+		}
+	};
+
+	thread_local FBlockCache ThreadBlockCache;
+
+	size_t& BlockCapacity(uint8* Block)
+	{
+		return *(size_t*)Block;
+	}
+}
+
+FMZFlatBufferAllocator& FMZFlatBufferAllocator::Get()
+{
+	static FMZFlatBufferAllocator Allocator;
+	return Allocator;
+}
+
+uint8_t* FMZFlatBufferAllocator::allocate(size_t size)
+{
+	auto& Cache = ThreadBlockCache;
+	//the smallest cached block that fits
+	int32 Best = INDEX_NONE;
+	for (uint32 i = 0; i < Cache.Count; ++i)
+	{
+		size_t Capacity = BlockCapacity(Cache.Blocks[i]);
+		if (Capacity >= size && (Best == INDEX_NONE || Capacity < BlockCapacity(Cache.Blocks[Best])))
+		{
+			Best = i;
+		}
+	}
+	if (Best != INDEX_NONE)
+	{
+		uint8* Block = Cache.Blocks[Best];
+		Cache.Blocks[Best] = Cache.Blocks[--Cache.Count];
+		PooledAllocations.fetch_add(1, std::memory_order_relaxed);
+		return Block + BlockHeaderSize;
+	}
+
+	HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	uint8* Block = (uint8*)FMemory::Malloc(size + BlockHeaderSize, BlockHeaderSize);
+	BlockCapacity(Block) = size;
+	return Block + BlockHeaderSize;
+}
+
+void FMZFlatBufferAllocator::deallocate(uint8_t* p, size_t)
+{
+	if (!p)
+	{
+		return;
+	}
+	uint8* Block = p - BlockHeaderSize;
+	auto& Cache = ThreadBlockCache;
+	if (BlockCapacity(Block) > MaxCachedBlockSize)
+	{
+		FMemory::Free(Block);
+		return;
+	}
+	if (Cache.Count == MaxCachedBlocks)
+	{
+		//keep the larger buffers, they cover more messages
+		uint32 Smallest = 0;
+		for (uint32 i = 1; i < Cache.Count; ++i)
+		{
+			if (BlockCapacity(Cache.Blocks[i]) < BlockCapacity(Cache.Blocks[Smallest]))
+			{
+				Smallest = i;
+			}
+		}
+		if (BlockCapacity(Cache.Blocks[Smallest]) >= BlockCapacity(Block))
+		{
+			FMemory::Free(Block);
+			return;
+		}
+		FMemory::Free(Cache.Blocks[Smallest]);
+		Cache.Blocks[Smallest] = Block;
+		return;
+	}
+	Cache.Blocks[Cache.Count++] = Block;
+}
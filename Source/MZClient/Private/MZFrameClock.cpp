@@ -0,0 +1,34 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZFrameClock.h"
+
+void FMZFrameClock::Rebase(double Seconds)
+{
+	SegmentStartSeconds = Seconds;
+	SegmentStartFrame = FrameIndex;
+}
+
+void FMZFrameClock::SetFrameDuration(uint32 InNumerator, uint32 InDenominator)
+{
+	if (InNumerator == Numerator && InDenominator == Denominator)
+	{
+		return;
+	}
+	Rebase(GetSeconds());
+	Numerator = InNumerator;
+	Denominator = InDenominator;
+}
+
+double FMZFrameClock::GetSeconds() const
+{
+	//whole seconds and the remainder are split so the product stays exact in 64 bits
+	uint64 Ticks = (FrameIndex - SegmentStartFrame) * Numerator;
+	return SegmentStartSeconds + double(Ticks / Denominator) + double(Ticks % Denominator) / Denominator;
+}
+
+FTimecode FMZFrameClock::GetTimecode() const
+{
+	FFrameRate Rate = GetFrameRate();
+	uint64 FramesPerDay = FMath::Max<uint64>(1, FMath::RoundToInt64(Rate.AsDecimal() * 86400.0));
+	return FTimecode::FromFrameNumber(FFrameNumber(int32(FrameIndex % FramesPerDay)), Rate, FTimecode::IsDropFormatTimecodeSupported(Rate));
+}
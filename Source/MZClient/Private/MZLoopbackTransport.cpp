@@ -0,0 +1,120 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZLoopbackTransport.h"
+#include "MZFlatBufferBuilder.h"
+
+bool FMZLoopbackTransport::IsRequested()
+{
+	return FParse::Param(FCommandLine::Get(), TEXT("mzloopback"));
+}
+
+void FMZLoopbackTransport::RegisterEventDelegates(mz::app::IEventDelegates* InEventDelegates)
+{
+	EventDelegates = InEventDelegates;
+}
+
+void FMZLoopbackTransport::TryConnect()
+{
+	if (bConnected.exchange(true))
+	{
+		return;
+	}
+	if (EventDelegates)
+	{
+		EventDelegates->OnAppConnected(nullptr);
+	}
+}
+
+void FMZLoopbackTransport::Disconnect()
+{
+	if (!bConnected.exchange(false))
+	{
+		return;
+	}
+	if (EventDelegates)
+	{
+		EventDelegates->OnConnectionClosed();
+	}
+}
+
+void FMZLoopbackTransport::Dispatch(TFunctionRef<void(mz::app::IEventDelegates&)> Event)
+{
+	if (bConnected && EventDelegates)
+	{
+		Event(*EventDelegates);
+	}
+}
+
+void FMZLoopbackTransport::InjectNodeUpdated(mz::fb::Node const& Node)
+{
+	Dispatch([&Node](mz::app::IEventDelegates& Delegates) { Delegates.OnNodeUpdated(Node); });
+}
+
+void FMZLoopbackTransport::InjectPinValue(mz::fb::UUID const& PinId, uint8_t const* Data, size_t Size, uint32_t FrameNumber, bool bReset)
+{
+	Dispatch([&](mz::app::IEventDelegates& Delegates) { Delegates.OnPinValueChanged(PinId, Data, Size, bReset, FrameNumber); });
+}
+
+template <typename T>
+void FMZLoopbackTransport::Record(EMZLoopbackMessage Type, T const& Table)
+{
+	OutboundCount.fetch_add(1, std::memory_order_relaxed);
+	if (!bRecordOutbound)
+	{
+		return;
+	}
+	//the caller owns the table's buffer, so it is packed into one the driver can keep
+	typename T::NativeTableType Native;
+	Table.UnPackTo(&Native);
+	FMZFlatBufferBuilder fbb;
+	fbb.Finish(T::Pack(fbb, &Native));
+	RecordedBytes.fetch_add(fbb.GetSize(), std::memory_order_relaxed);
+	Record(FMessage{ .Type = Type, .Time = FPlatformTime::Seconds(), .Buffer = fbb.Release() });
+}
+
+void FMZLoopbackTransport::Record(FMessage&& Message)
+{
+	RecordedCount.fetch_add(1, std::memory_order_relaxed);
+	std::unique_lock Lock(OutboundGuard);
+	Outbound.push_back(std::move(Message));
+}
+
+std::vector<FMZLoopbackTransport::FMessage> FMZLoopbackTransport::TakeOutbound()
+{
+	std::unique_lock Lock(OutboundGuard);
+	return std::move(Outbound);
+}
+
+void FMZLoopbackTransport::Send(mz::app::AppEvent const& Event)
+{
+	Record(EMZLoopbackMessage::AppEvent, Event);
+}
+
+void FMZLoopbackTransport::SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update)
+{
+	Record(EMZLoopbackMessage::PartialNodeUpdate, Update);
+}
+
+void FMZLoopbackTransport::SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs)
+{
+	OutboundCount.fetch_add(1, std::memory_order_relaxed);
+	if (bRecordOutbound)
+	{
+		Record(FMessage{ .Type = EMZLoopbackMessage::PinShowAsChange, .Time = FPlatformTime::Seconds(), .PinId = PinId, .ShowAs = ShowAs });
+	}
+}
+
+void FMZLoopbackTransport::SendContextMenuUpdate(mz::ContextMenuUpdate const& Update)
+{
+	Record(EMZLoopbackMessage::ContextMenuUpdate, Update);
+}
+
+void FMZLoopbackTransport::NotifyPinValueChanged(mz::PinValueChanged const& Value)
+{
+	Record(EMZLoopbackMessage::PinValueChanged, Value);
+}
+
+void FMZLoopbackTransport::UpdateStringList(mz::app::UpdateStringList const& List)
+{
+	Record(EMZLoopbackMessage::StringList, List);
+}
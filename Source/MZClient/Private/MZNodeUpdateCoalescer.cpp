@@ -0,0 +1,198 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZNodeUpdateCoalescer.h"
+#include "MZClient.h"
+
+static bool HasFlag(mz::ClearFlags Flags, mz::ClearFlags Flag)
+{
+	return (Flags & Flag) != mz::ClearFlags::NONE;
+}
+
+static bool SameId(mz::fb::UUID const& A, mz::fb::UUID const& B)
+{
+	return !FMemory::Memcmp(&A, &B, sizeof(mz::fb::UUID));
+}
+
+static bool ContainsId(std::vector<mz::fb::UUID> const& Ids, mz::fb::UUID const& Id)
+{
+	return std::any_of(Ids.begin(), Ids.end(), [&Id](auto const& Other) { return SameId(Other, Id); });
+}
+
+//Newer definitions of the same id replace the pending one in place, removed ids drop their pending definition
+template <typename T>
+static void MergeAdded(std::vector<std::unique_ptr<T>>& Pending, std::vector<std::unique_ptr<T>>& Added)
+{
+	for (auto& Item : Added)
+	{
+		auto It = std::find_if(Pending.begin(), Pending.end(), [&Item](auto const& Other) { return SameId(Other->id, Item->id); });
+		if (It != Pending.end())
+		{
+			*It = std::move(Item);
+		}
+		else
+		{
+			Pending.push_back(std::move(Item));
+		}
+	}
+}
+
+template <typename T>
+static void MergeRemoved(std::vector<std::unique_ptr<T>>& PendingAdded, std::vector<mz::fb::UUID>& PendingRemoved, std::vector<mz::fb::UUID> const& Removed)
+{
+	for (auto const& Id : Removed)
+	{
+		std::erase_if(PendingAdded, [&Id](auto const& Item) { return SameId(Item->id, Id); });
+		if (!ContainsId(PendingRemoved, Id))
+		{
+			PendingRemoved.push_back(Id);
+		}
+	}
+}
+
+template <typename T>
+static bool AddsRemoved(std::vector<std::unique_ptr<T>> const& Added, std::vector<mz::fb::UUID> const& PendingRemoved)
+{
+	return std::any_of(Added.begin(), Added.end(), [&PendingRemoved](auto const& Item) { return ContainsId(PendingRemoved, Item->id); });
+}
+
+FMZNodeUpdateCoalescer::FMZNodeUpdateCoalescer(FMZClient* InMZClient)
+	: MZClient(InMZClient)
+{
+}
+
+void FMZNodeUpdateCoalescer::SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update, TOptional<uint64> StateHash)
+{
+	++SubmittedCount;
+	auto Unpacked = std::make_unique<mz::TPartialNodeUpdate>();
+	Update.UnPackTo(Unpacked.get());
+	FGuid NodeId = *(FGuid*)&Unpacked->node_id;
+
+	if (int32* PendingIndex = PendingByNode.Find(NodeId))
+	{
+		if (CanMerge(*PendingIndex, *Unpacked))
+		{
+			FPendingUpdate& Target = Pending[*PendingIndex];
+			Merge(*Target.Update, MoveTemp(*Unpacked));
+			//MediaZ only ends up with a known full state if that state is what was merged last
+			Target.StateHash = StateHash;
+			return;
+		}
+		Flush();
+	}
+	PendingByNode.Add(NodeId, int32(Pending.size()));
+	Pending.push_back({ std::move(Unpacked), StateHash });
+}
+
+bool FMZNodeUpdateCoalescer::CanMerge(int32 PendingIndex, mz::TPartialNodeUpdate const& Update) const
+{
+	auto const& Target = *Pending[PendingIndex].Update;
+	bool bRemoves = Update.clear_flags != mz::ClearFlags::NONE || !Update.pins_to_delete.empty() ||
+		!Update.functions_to_delete.empty() || !Update.nodes_to_delete.empty();
+	if (bRemoves && PendingIndex != int32(Pending.size()) - 1)
+	{
+		return false;
+	}
+	return !AddsRemoved(Update.pins_to_add, Target.pins_to_delete) &&
+		!AddsRemoved(Update.functions_to_add, Target.functions_to_delete) &&
+		!AddsRemoved(Update.nodes_to_add, Target.nodes_to_delete);
+}
+
+void FMZNodeUpdateCoalescer::Merge(mz::TPartialNodeUpdate& Target, mz::TPartialNodeUpdate&& Update)
+{
+	//a clear makes everything pending of that kind irrelevant
+	if (HasFlag(Update.clear_flags, mz::ClearFlags::CLEAR_PINS))
+	{
+		Target.pins_to_add.clear();
+		Target.pins_to_delete.clear();
+		Target.pin_updates.clear();
+	}
+	if (HasFlag(Update.clear_flags, mz::ClearFlags::CLEAR_FUNCTIONS))
+	{
+		Target.functions_to_add.clear();
+		Target.functions_to_delete.clear();
+	}
+	if (HasFlag(Update.clear_flags, mz::ClearFlags::CLEAR_NODES))
+	{
+		Target.nodes_to_add.clear();
+		Target.nodes_to_delete.clear();
+	}
+	if (HasFlag(Update.clear_flags, mz::ClearFlags::CLEAR_METADATA))
+	{
+		Target.meta_data_map.clear();
+	}
+	Target.clear_flags = Target.clear_flags | Update.clear_flags;
+
+	MergeRemoved(Target.pins_to_add, Target.pins_to_delete, Update.pins_to_delete);
+	//pending updates of a deleted pin would reach MediaZ after the pin is gone
+	std::erase_if(Target.pin_updates, [&Update](auto const& PinUpdate) { return ContainsId(Update.pins_to_delete, PinUpdate->pin_id); });
+	MergeRemoved(Target.functions_to_add, Target.functions_to_delete, Update.functions_to_delete);
+	MergeRemoved(Target.nodes_to_add, Target.nodes_to_delete, Update.nodes_to_delete);
+	MergeAdded(Target.pins_to_add, Update.pins_to_add);
+	MergeAdded(Target.functions_to_add, Update.functions_to_add);
+	MergeAdded(Target.nodes_to_add, Update.nodes_to_add);
+
+	//pin updates are partial, they are kept in order
+	for (auto& PinUpdate : Update.pin_updates)
+	{
+		Target.pin_updates.push_back(std::move(PinUpdate));
+	}
+	if (!Update.status_messages.empty())
+	{
+		Target.status_messages = std::move(Update.status_messages);
+	}
+	for (auto& Entry : Update.meta_data_map)
+	{
+		auto It = std::find_if(Target.meta_data_map.begin(), Target.meta_data_map.end(), [&Entry](auto const& Other) { return Other->key == Entry->key; });
+		if (It != Target.meta_data_map.end())
+		{
+			*It = std::move(Entry);
+		}
+		else
+		{
+			Target.meta_data_map.push_back(std::move(Entry));
+		}
+	}
+}
+
+void FMZNodeUpdateCoalescer::Flush()
+{
+	if (Pending.empty())
+	{
+		return;
+	}
+	bool bConnected = MZClient->IsConnected();
+	FMZFlatBufferBuilder fbb;
+	for (auto& [Update, StateHash] : Pending)
+	{
+		if (bConnected)
+		{
+			fbb.Clear();
+			fbb.Finish(mz::PartialNodeUpdate::Pack(fbb, Update.get()));
+			MZClient->AppServiceClient->SendPartialNodeUpdate(*flatbuffers::GetRoot<mz::PartialNodeUpdate>(fbb.GetBufferPointer()));
+			++SentCount;
+		}
+		UpdateSentState(*(FGuid*)&Update->node_id, bConnected ? StateHash : TOptional<uint64>());
+	}
+	Pending.clear();
+	PendingByNode.Reset();
+}
+
+void FMZNodeUpdateCoalescer::UpdateSentState(FGuid const& NodeId, TOptional<uint64> StateHash)
+{
+	if (StateHash)
+	{
+		MZClient->OutboundDedup.Commit(EMZOutboundKind::NodeUpdate, NodeId, *StateHash);
+	}
+	else
+	{
+		MZClient->OutboundDedup.Invalidate(EMZOutboundKind::NodeUpdate, NodeId);
+	}
+	if (!GetParentId)
+	{
+		return;
+	}
+	for (FGuid Id = GetParentId(NodeId); Id.IsValid(); Id = GetParentId(Id))
+	{
+		MZClient->OutboundDedup.Invalidate(EMZOutboundKind::NodeUpdate, Id);
+	}
+}
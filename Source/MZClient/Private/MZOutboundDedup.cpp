@@ -0,0 +1,83 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZOutboundDedup.h"
+#include "MZClient.h"
+#include "Hash/CityHash.h"
+
+static TAutoConsoleVariable<bool> CVarOutboundDedup(TEXT("mediaz.OutboundDedup"), true, TEXT("Skips node updates, pin values and lists that are identical to the last ones sent to MediaZ"));
+
+static FAutoConsoleCommandWithOutputDevice OutboundDedupStatsCommand(
+	TEXT("mediaz.OutboundDedupStats"),
+	TEXT("Prints how many messages and bytes were not sent to MediaZ because they were unchanged."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			if (FMZClient* Client = FModuleManager::GetModulePtr<FMZClient>("MZClient"))
+			{
+				Ar.Logf(TEXT("Suppressed %llu messages, %llu bytes"), Client->OutboundDedup.SuppressedMessages.load(), Client->OutboundDedup.SuppressedBytes.load());
+			}
+		}));
+
+uint64 FMZOutboundDedup::MakeKey(EMZOutboundKind Kind, void const* Target, size_t Size)
+{
+	return CityHash64WithSeed((char const*)Target, Size, uint64(Kind));
+}
+
+bool FMZOutboundDedup::ShouldSend(EMZOutboundKind Kind, FGuid const& Target, void const* Data, size_t Size)
+{
+	TOptional<uint64> Hash;
+	return ShouldSend(MakeKey(Kind, &Target, sizeof(Target)), Data, Size, true, Hash);
+}
+
+bool FMZOutboundDedup::ShouldSend(EMZOutboundKind Kind, FAnsiStringView Target, void const* Data, size_t Size)
+{
+	TOptional<uint64> Hash;
+	return ShouldSend(MakeKey(Kind, Target.GetData(), Target.Len()), Data, Size, true, Hash);
+}
+
+bool FMZOutboundDedup::ShouldSendDeferred(EMZOutboundKind Kind, FGuid const& Target, void const* Data, size_t Size, TOptional<uint64>& OutHash)
+{
+	return ShouldSend(MakeKey(Kind, &Target, sizeof(Target)), Data, Size, false, OutHash);
+}
+
+void FMZOutboundDedup::Commit(EMZOutboundKind Kind, FGuid const& Target, uint64 Hash)
+{
+	uint64 Key = MakeKey(Kind, &Target, sizeof(Target));
+	std::unique_lock Lock(Guard);
+	LastSent.Add(Key, Hash);
+}
+
+bool FMZOutboundDedup::ShouldSend(uint64 Key, void const* Data, size_t Size, bool bRecord, TOptional<uint64>& OutHash)
+{
+	if (!CVarOutboundDedup.GetValueOnAnyThread())
+	{
+		return true;
+	}
+	uint64 Hash = CityHash64((char const*)Data, Size);
+	std::unique_lock Lock(Guard);
+	uint64 const* Last = LastSent.Find(Key);
+	if (Last && *Last == Hash)
+	{
+		SuppressedMessages.fetch_add(1, std::memory_order_relaxed);
+		SuppressedBytes.fetch_add(Size, std::memory_order_relaxed);
+		return false;
+	}
+	if (bRecord)
+	{
+		LastSent.Add(Key, Hash);
+	}
+	OutHash = Hash;
+	return true;
+}
+
+void FMZOutboundDedup::Invalidate(EMZOutboundKind Kind, FGuid const& Target)
+{
+	uint64 Key = MakeKey(Kind, &Target, sizeof(Target));
+	std::unique_lock Lock(Guard);
+	LastSent.Remove(Key);
+}
+
+void FMZOutboundDedup::Reset()
+{
+	std::unique_lock Lock(Guard);
+	LastSent.Reset();
+}
@@ -0,0 +1,474 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZPinDataQueue.h"
+#include "MZClient.h"
+
+static TAutoConsoleVariable<int32> CVarPinQueueCapacity(
+	TEXT("mediaz.PinQueueCapacity"),
+	64,
+	TEXT("Number of values each pin queue can hold before the oldest ones are dropped to make room for new values coming from MediaZ. Clamped to 2..65536 and rounded up to a power of two, applies to queues created afterwards."));
+
+static TAutoConsoleVariable<bool> CVarJitterBuffer(
+	TEXT("mediaz.JitterBuffer"),
+	false,
+	TEXT("Serve frame-numbered input pins from an adaptive jitter buffer instead of blocking until the current frame arrives."));
+
+static TAutoConsoleVariable<float> CVarJitterBufferTargetLateRate(
+	TEXT("mediaz.JitterBuffer.TargetLateRate"),
+	0.01f,
+	TEXT("Fraction of frames allowed to miss their sample before the jitter buffer grows."));
+
+static TAutoConsoleVariable<int32> CVarJitterBufferMinDepth(
+	TEXT("mediaz.JitterBuffer.MinDepth"),
+	0,
+	TEXT("Minimum jitter buffer depth in frames."));
+
+static TAutoConsoleVariable<int32> CVarJitterBufferMaxDepth(
+	TEXT("mediaz.JitterBuffer.MaxDepth"),
+	4,
+	TEXT("Maximum jitter buffer depth in frames."));
+
+static TAutoConsoleVariable<int32> CVarJitterBufferWindow(
+	TEXT("mediaz.JitterBuffer.Window"),
+	120,
+	TEXT("Number of frames the late rate is measured over before the jitter buffer depth is adjusted."));
+
+static FAutoConsoleCommandWithOutputDevice DumpPinQueueStatsCommand(
+	TEXT("mediaz.PinQueueStats"),
+	TEXT("Prints jitter buffer and overrun counters of every registered pin queue."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			FMZClient* Client = FModuleManager::GetModulePtr<FMZClient>("MZClient");
+			if (Client && Client->EventDelegates)
+			{
+				Client->EventDelegates->DumpStats(Ar);
+			}
+		}));
+
+PinDataQueue::PinDataQueue(uint32_t InCapacity, FString const& InDebugName)
+	: DebugName(InDebugName)
+	, Capacity(FMath::RoundUpToPowerOfTwo(FMath::Clamp(InCapacity, 2u, MaxCapacity)))
+	, Mask(Capacity - 1)
+	, Slots(std::make_unique<Slot[]>(Capacity))
+{
+	for (uint32_t i = 0; i < Capacity; ++i)
+	{
+		Slots[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool PinDataQueue::Enqueue(MZPinPayload const& payload, uint32_t frameNumber)
+{
+	bool overwrote = false;
+	uint32_t head = Head.load(std::memory_order_relaxed);
+	Slot& slot = Slots[head & Mask];
+	while (slot.Sequence.load(std::memory_order_acquire) != head)
+	{
+		//full, take the oldest value away from the consumer, if it got there first wait until it moved the value out
+		uint32_t tail = Tail.load(std::memory_order_relaxed);
+		if (head - tail >= Capacity && Tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			slot.Value.Payload.Reset();
+			slot.Sequence.store(tail + Capacity, std::memory_order_release);
+			Overruns.fetch_add(1, std::memory_order_relaxed);
+			overwrote = true;
+		}
+		else
+		{
+			FPlatformProcess::Yield();
+		}
+	}
+
+	slot.Value.Payload = payload;
+	slot.Value.FrameNumber = frameNumber;
+	slot.Sequence.store(head + 1, std::memory_order_release);
+	Head.store(head + 1, std::memory_order_release);
+	NewestFrame.store(frameNumber, std::memory_order_relaxed);
+
+	//pairs with the fence in DiscardExcessThenDequeue so either we see the waiter or it sees the new head
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (ConsumerWaiting.load(std::memory_order_relaxed) && frameNumber >= WaitingForFrame.load(std::memory_order_relaxed))
+	{
+		std::scoped_lock<std::mutex> lock(WaitMutex);
+		WaitCV.notify_one();
+	}
+	return !overwrote;
+}
+
+void PinDataQueue::RequestReset()
+{
+	ResetTo.store(Head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	ResetPending.store(true, std::memory_order_release);
+}
+
+void PinDataQueue::ApplyPendingReset()
+{
+	if (!ResetPending.exchange(false, std::memory_order_acquire))
+	{
+		return;
+	}
+
+	//never move backwards if the consumer already passed the reset point
+	uint32_t resetTo = ResetTo.load(std::memory_order_relaxed);
+	while (int32_t(resetTo - Tail.load(std::memory_order_relaxed)) > 0 && Claim(nullptr))
+	{
+	}
+}
+
+bool PinDataQueue::Claim(Sample* out)
+{
+	for (;;)
+	{
+		uint32_t tail = Tail.load(std::memory_order_relaxed);
+		Slot& slot = Slots[tail & Mask];
+		if (slot.Sequence.load(std::memory_order_acquire) != tail + 1)
+		{
+			return false;
+		}
+		//the producer may have dropped this value to make room, then try the next one
+		if (!Tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			continue;
+		}
+
+		if (out)
+		{
+			out->Payload = MoveTemp(slot.Value.Payload);
+			out->FrameNumber = slot.Value.FrameNumber;
+		}
+		else
+		{
+			slot.Value.Payload.Reset();
+		}
+		slot.Sequence.store(tail + Capacity, std::memory_order_release);
+		return true;
+	}
+}
+
+bool PinDataQueue::Dequeue()
+{
+	return Claim(&Latest);
+}
+
+bool PinDataQueue::DequeueUpTo(uint32_t requestedFrameNumber, bool wait, double waitDeadline, uint32_t& dequeuedCount)
+{
+	ApplyPendingReset();
+
+	auto DequeueUntilRequested = [&]()
+		{
+			while (Dequeue())
+			{
+				dequeuedCount++;
+				if (Latest.FrameNumber >= requestedFrameNumber)
+					return true;
+			}
+			return false;
+		};
+
+	//only block on pins that were live last frame, a stopped stream should not stall every frame
+	if (!DequeueUntilRequested() && wait && LiveNow)
+	{
+		double remaining = waitDeadline - FPlatformTime::Seconds();
+		if (remaining > 0)
+		{
+			std::unique_lock<std::mutex> lock(WaitMutex);
+			WaitingForFrame.store(requestedFrameNumber, std::memory_order_relaxed);
+			ConsumerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			WaitCV.wait_for(lock, std::chrono::duration<double>(remaining), DequeueUntilRequested);
+			ConsumerWaiting.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	LiveNow = dequeuedCount > 0;
+	return LiveNow;
+}
+
+PinDataQueue::Sample const* PinDataQueue::DiscardExcessThenDequeue(uint32_t requestedFrameNumber, bool wait, double waitDeadline)
+{
+	bool oldLiveNow = LiveNow;
+	uint32_t dequeuedCount = 0;
+	bool dequeued = DequeueUpTo(requestedFrameNumber, wait, waitDeadline, dequeuedCount);
+
+	if (oldLiveNow != LiveNow)
+		UE_LOG(LogMZClient, Warning, TEXT("LiveNow Changed"));
+
+	if (LiveNow && Latest.FrameNumber != requestedFrameNumber)
+		UE_LOG(LogMZClient, Warning, TEXT("Mismatch between popped frame number and requested frame number: %i, %i"), Latest.FrameNumber, requestedFrameNumber);
+
+	return dequeued ? &Latest : nullptr;
+}
+
+PinDataQueue::Sample const* PinDataQueue::DequeueBuffered(uint32_t currentFrameNumber, double waitDeadline)
+{
+	uint32_t target = currentFrameNumber - FMath::Min(Depth, currentFrameNumber);
+
+	float skew = float(int32_t(NewestFrame.load(std::memory_order_relaxed) - currentFrameNumber));
+	Stats.ArrivalSkew.store(FMath::Lerp(Stats.ArrivalSkew.load(std::memory_order_relaxed), skew, 0.05f), std::memory_order_relaxed);
+
+	uint32_t dequeuedCount = 0;
+	bool dequeued = DequeueUpTo(target, true, waitDeadline, dequeuedCount);
+	if (dequeuedCount > 1)
+	{
+		Stats.Dropped.fetch_add(dequeuedCount - 1, std::memory_order_relaxed);
+	}
+
+	bool late = !dequeued || int32_t(Latest.FrameNumber - target) < 0;
+	if (late)
+	{
+		Stats.Late.fetch_add(1, std::memory_order_relaxed);
+		WindowLate++;
+	}
+	else if (Tail.load(std::memory_order_relaxed) != Head.load(std::memory_order_acquire))
+	{
+		Stats.Early.fetch_add(1, std::memory_order_relaxed);
+		WindowEarly++;
+	}
+	else
+	{
+		Stats.OnTime.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	WindowFrames++;
+	AdaptDepth();
+
+	return dequeued ? &Latest : nullptr;
+}
+
+void PinDataQueue::AdaptDepth()
+{
+	uint32_t minDepth = FMath::Max(CVarJitterBufferMinDepth.GetValueOnAnyThread(), 0);
+	uint32_t maxDepth = FMath::Max<uint32_t>(CVarJitterBufferMaxDepth.GetValueOnAnyThread(), minDepth);
+	uint32_t window = FMath::Max(CVarJitterBufferWindow.GetValueOnAnyThread(), 1);
+
+	uint32_t newDepth = FMath::Clamp(Depth, minDepth, maxDepth);
+	if (WindowFrames >= window)
+	{
+		float lateRate = WindowLate / float(WindowFrames);
+		if (lateRate > CVarJitterBufferTargetLateRate.GetValueOnAnyThread() && newDepth < maxDepth)
+		{
+			newDepth++;
+		}
+		//shrink only when every frame of the window had spare samples buffered
+		else if (WindowLate == 0 && WindowEarly == WindowFrames && newDepth > minDepth)
+		{
+			newDepth--;
+		}
+		WindowFrames = WindowLate = WindowEarly = 0;
+	}
+
+	if (newDepth != Depth)
+	{
+		UE_LOG(LogMZClient, Display, TEXT("Jitter buffer depth of pin %s is changed from %u to %u frames"), *DebugName, Depth, newDepth);
+		Depth = newDepth;
+		Stats.Depth.store(Depth, std::memory_order_relaxed);
+	}
+}
+
+void PinDataQueue::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("%s: depth %u, skew %.2f, on time %llu, early %llu, late %llu, dropped %llu, overruns %llu"),
+		*DebugName,
+		Stats.Depth.load(),
+		Stats.ArrivalSkew.load(),
+		Stats.OnTime.load(),
+		Stats.Early.load(),
+		Stats.Late.load(),
+		Stats.Dropped.load(),
+		Overruns.load());
+}
+
+PinDataQueues::PinDataQueues()
+	: Slots(std::make_unique<PinQueueSlot[]>(MaxPinQueues))
+	, IndexMap(new PinIndexMap())
+{
+	FreeSlots.reserve(MaxPinQueues);
+	for (uint32_t i = MaxPinQueues; i > 0; --i)
+	{
+		FreeSlots.push_back(i - 1);
+	}
+}
+
+PinDataQueues::~PinDataQueues()
+{
+	delete IndexMap.load();
+}
+
+void PinDataQueues::PublishIndexMap(PinIndexMap* NewMap)
+{
+	PinIndexMap const* OldMap = IndexMap.exchange(NewMap);
+	while (ActiveReaders.load() != 0)
+	{
+		FPlatformProcess::Yield();
+	}
+	delete OldMap;
+}
+
+PinQueueHandle PinDataQueues::RegisterPin(mz::fb::UUID const& pinId, FString const& DebugName, bool bFrameOrdered)
+{
+	uuids::uuid id(pinId.bytes()->begin(), pinId.bytes()->end());
+
+	std::scoped_lock<std::mutex> lock(Guard);
+	PinIndexMap const* CurrentMap = IndexMap.load();
+	auto it = CurrentMap->find(id);
+	if (it != CurrentMap->end())
+	{
+		PinQueueSlot& slot = Slots[it->second];
+		slot.RefCount++;
+		slot.FrameOrdered.store(bFrameOrdered);
+		return { it->second, slot.Generation };
+	}
+
+	if (FreeSlots.empty())
+	{
+		UE_LOG(LogMZClient, Error, TEXT("Pin queue limit (%u) is reached, values of the pin will be ignored."), MaxPinQueues);
+		return {};
+	}
+
+	uint32_t index = FreeSlots.back();
+	FreeSlots.pop_back();
+
+	PinQueueSlot& slot = Slots[index];
+	uint32_t capacity = FMath::Clamp(CVarPinQueueCapacity.GetValueOnAnyThread(), 2, int32(PinDataQueue::MaxCapacity));
+	slot.Queue = std::make_unique<PinDataQueue>(capacity, DebugName);
+	slot.Id = id;
+	slot.RefCount = 1;
+	slot.FrameOrdered.store(bFrameOrdered);
+
+	PinIndexMap* NewMap = new PinIndexMap(*CurrentMap);
+	NewMap->emplace(id, index);
+	PublishIndexMap(NewMap);
+
+	return { index, slot.Generation };
+}
+
+bool PinDataQueues::UnregisterPin(PinQueueHandle& handle)
+{
+	if (!handle.IsValid())
+	{
+		return false;
+	}
+
+	PinQueueHandle released = handle;
+	handle = {};
+
+	std::scoped_lock<std::mutex> lock(Guard);
+	PinQueueSlot& slot = Slots[released.Index];
+	if (slot.Generation != released.Generation || --slot.RefCount > 0)
+	{
+		return false;
+	}
+
+	PinIndexMap* NewMap = new PinIndexMap(*IndexMap.load());
+	NewMap->erase(slot.Id);
+	//after this no producer can reach the queue anymore
+	PublishIndexMap(NewMap);
+
+	slot.Queue.reset();
+	slot.Generation++;
+	FreeSlots.push_back(released.Index);
+	return true;
+}
+
+void PinDataQueues::SetPinFrameOrdered(PinQueueHandle handle, bool bFrameOrdered)
+{
+	if (handle.IsValid() && Slots[handle.Index].Generation == handle.Generation)
+	{
+		Slots[handle.Index].FrameOrdered.store(bFrameOrdered);
+	}
+}
+
+PinQueueHandle PinDataQueues::FindPin(mz::fb::UUID const& pinId)
+{
+	uuids::uuid id(pinId.bytes()->begin(), pinId.bytes()->end());
+
+	PinQueueHandle handle;
+	ReadIndexMap([&](PinIndexMap const& map)
+		{
+			auto it = map.find(id);
+			if (it != map.end())
+			{
+				handle = { it->second, Slots[it->second].Generation };
+			}
+		});
+	return handle;
+}
+
+void PinDataQueues::OnPinValueChanged(mz::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset, uint32_t frameNumber)
+{
+	PushPinValue(pinId, reset ? MZPinPayload() : MZPinPayload(data, size), reset, frameNumber);
+}
+
+bool PinDataQueues::PushPinValue(mz::fb::UUID const& pinId, MZPinPayload const& payload, bool reset, uint32_t frameNumber)
+{
+	if (reset)
+	{
+		ReadIndexMap([&](PinIndexMap const& map)
+			{
+				for (auto& [_, index] : map)
+					Slots[index].Queue->RequestReset();
+			});
+
+		return false;
+	}
+
+	uuids::uuid id(pinId.bytes()->begin(), pinId.bytes()->end());
+	bool frameOrdered = false;
+	ReadIndexMap([&](PinIndexMap const& map)
+		{
+			auto it = map.find(id);
+			if (it == map.end())
+			{
+				UnregisteredDrops.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			PinQueueSlot& slot = Slots[it->second];
+			slot.Queue->Enqueue(payload, frameNumber);
+			frameOrdered = slot.FrameOrdered.load(std::memory_order_relaxed);
+		});
+	return frameOrdered;
+}
+
+PinDataQueue::Sample const* PinDataQueues::Pop(PinQueueHandle handle, bool wait, uint32_t frameNumber, double waitDeadline)
+{
+	if (!handle.IsValid())
+	{
+		return nullptr;
+	}
+
+	PinQueueSlot& slot = Slots[handle.Index];
+	if (slot.Generation != handle.Generation || !slot.Queue)
+	{
+		return nullptr;
+	}
+	return slot.Queue->DiscardExcessThenDequeue(frameNumber, wait, waitDeadline);
+}
+
+PinDataQueue::Sample const* PinDataQueues::PopBuffered(PinQueueHandle handle, uint32_t frameNumber, double waitDeadline)
+{
+	if (!CVarJitterBuffer.GetValueOnAnyThread())
+	{
+		return Pop(handle, true, frameNumber, waitDeadline);
+	}
+
+	if (!handle.IsValid())
+	{
+		return nullptr;
+	}
+
+	PinQueueSlot& slot = Slots[handle.Index];
+	if (slot.Generation != handle.Generation || !slot.Queue)
+	{
+		return nullptr;
+	}
+	return slot.Queue->DequeueBuffered(frameNumber, waitDeadline);
+}
+
+void PinDataQueues::DumpStats(FOutputDevice& Ar)
+{
+	std::scoped_lock<std::mutex> lock(Guard);
+	for (auto& [_, index] : *IndexMap.load())
+	{
+		Slots[index].Queue->DumpStats(Ar);
+	}
+}
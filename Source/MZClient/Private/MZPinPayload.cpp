@@ -0,0 +1,122 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZPinPayload.h"
+#include "Containers/LockFreeFixedSizeAllocator.h"
+
+namespace
+{
+	// Block sizes include the header, anything bigger goes to the regular allocator
+	constexpr uint32_t SlabBlockSizes[] = { 128, 512, 2048, 8192, 32768 };
+	constexpr uint32_t HeapSizeClass = UE_ARRAY_COUNT(SlabBlockSizes);
+
+	TLockFreeFixedSizeAllocator<128, PLATFORM_CACHE_LINE_SIZE> Slab128;
+	TLockFreeFixedSizeAllocator<512, PLATFORM_CACHE_LINE_SIZE> Slab512;
+	TLockFreeFixedSizeAllocator<2048, PLATFORM_CACHE_LINE_SIZE> Slab2K;
+	TLockFreeFixedSizeAllocator<8192, PLATFORM_CACHE_LINE_SIZE> Slab8K;
+	TLockFreeFixedSizeAllocator<32768, PLATFORM_CACHE_LINE_SIZE> Slab32K;
+
+	uint32_t GetSizeClass(size_t blockSize)
+	{
+		for (uint32_t i = 0; i < HeapSizeClass; ++i)
+		{
+			if (blockSize <= SlabBlockSizes[i])
+			{
+				return i;
+			}
+		}
+		return HeapSizeClass;
+	}
+
+	void* AllocateBlock(uint32_t sizeClass, size_t blockSize)
+	{
+		switch (sizeClass)
+		{
+		case 0: return Slab128.Allocate();
+		case 1: return Slab512.Allocate();
+		case 2: return Slab2K.Allocate();
+		case 3: return Slab8K.Allocate();
+		case 4: return Slab32K.Allocate();
+		default: return FMemory::Malloc(blockSize, 16);
+		}
+	}
+
+	void FreeBlock(uint32_t sizeClass, void* block)
+	{
+		switch (sizeClass)
+		{
+		case 0: Slab128.Free(block); break;
+		case 1: Slab512.Free(block); break;
+		case 2: Slab2K.Free(block); break;
+		case 3: Slab8K.Free(block); break;
+		case 4: Slab32K.Free(block); break;
+		default: FMemory::Free(block); break;
+		}
+	}
+}
+
+MZPinPayload::MZPinPayload(uint8_t const* data, size_t size)
+{
+	size_t blockSize = sizeof(FBlock) + size;
+	uint32_t sizeClass = GetSizeClass(blockSize);
+	Block = new (AllocateBlock(sizeClass, blockSize)) FBlock{ {1}, uint32_t(size), sizeClass };
+	if (size)
+	{
+		FMemory::Memcpy(Block + 1, data, size);
+	}
+}
+
+MZPinPayload::MZPinPayload(MZPinPayload const& other)
+	: Block(other.Block)
+{
+	if (Block)
+	{
+		Block->RefCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+MZPinPayload::MZPinPayload(MZPinPayload&& other) noexcept
+	: Block(other.Block)
+{
+	other.Block = nullptr;
+}
+
+MZPinPayload& MZPinPayload::operator=(MZPinPayload const& other)
+{
+	if (Block != other.Block)
+	{
+		Reset();
+		Block = other.Block;
+		if (Block)
+		{
+			Block->RefCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	return *this;
+}
+
+MZPinPayload& MZPinPayload::operator=(MZPinPayload&& other) noexcept
+{
+	if (this != &other)
+	{
+		Reset();
+		Block = other.Block;
+		other.Block = nullptr;
+	}
+	return *this;
+}
+
+MZPinPayload::~MZPinPayload()
+{
+	Reset();
+}
+
+void MZPinPayload::Reset()
+{
+	if (Block && Block->RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		uint32_t sizeClass = Block->SizeClass;
+		Block->~FBlock();
+		FreeBlock(sizeClass, Block);
+	}
+	Block = nullptr;
+}
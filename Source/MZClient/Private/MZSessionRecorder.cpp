@@ -0,0 +1,529 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZSessionRecorder.h"
+#include "MZClient.h"
+#include "MZLoopbackTransport.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+
+static TAutoConsoleVariable<int32> CVarRecordMaxSizeMB(TEXT("mediaz.Record.MaxSizeMB"), 1024, TEXT("Size in megabytes a session recording stops growing at, later events are not recorded"));
+static TAutoConsoleVariable<int32> CVarRecordFlushIntervalMs(TEXT("mediaz.Record.FlushIntervalMs"), 100, TEXT("Interval in milliseconds recorded events are written to disk at, a crash loses at most the events of one interval"));
+
+static constexpr int64 RecordChunkSize = 1 << 20;
+//A disk that falls this far behind drops events instead of growing the memory without bound
+static constexpr int32 MaxPendingChunks = 64;
+
+static FMZClient* GetMZClient()
+{
+	return FModuleManager::GetModulePtr<FMZClient>("MZClient");
+}
+
+static FString GetSessionFilename(TArray<FString> const& Args)
+{
+	if (!Args.IsEmpty())
+	{
+		return FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir(), Args[0]);
+	}
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MediaZ"), FString::Printf(TEXT("Session-%s.mzrec"), *FDateTime::Now().ToString()));
+}
+
+static FAutoConsoleCommand RecordStartCommand(
+	TEXT("mediaz.Record.Start"),
+	TEXT("Starts recording the events received from MediaZ. Usage: mediaz.Record.Start [File]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](TArray<FString> const& Args)
+		{
+			if (FMZClient* Client = GetMZClient())
+			{
+				if (Client->SessionReplayer && Client->SessionReplayer->IsReplaying())
+				{
+					UE_LOG(LogMZClient, Warning, TEXT("A session is being replayed, it cannot be recorded."));
+					return;
+				}
+				Client->SessionRecorder.Start(GetSessionFilename(Args));
+			}
+		}));
+
+static FAutoConsoleCommand RecordStopCommand(
+	TEXT("mediaz.Record.Stop"),
+	TEXT("Stops recording and writes the session log."),
+	FConsoleCommandDelegate::CreateLambda([]()
+		{
+			if (FMZClient* Client = GetMZClient())
+			{
+				Client->SessionRecorder.Stop();
+			}
+		}));
+
+static FAutoConsoleCommand ReplayCommand(
+	TEXT("mediaz.Replay"),
+	TEXT("Replays a recorded session and reports the per frame cost of handling it. Usage: mediaz.Replay File [max]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](TArray<FString> const& Args)
+		{
+			FMZClient* Client = GetMZClient();
+			if (!Client || !Client->SessionReplayer || Args.IsEmpty())
+			{
+				return;
+			}
+			if (Client->SessionRecorder.IsRecording())
+			{
+				UE_LOG(LogMZClient, Warning, TEXT("A session is being recorded, stop the recording before replaying."));
+				return;
+			}
+			Client->SessionReplayer->Start(GetSessionFilename(Args), Args.Num() > 1 && Args[1] == TEXT("max"));
+		}));
+
+static FAutoConsoleCommand ReplayStopCommand(
+	TEXT("mediaz.Replay.Stop"),
+	TEXT("Stops the session replay."),
+	FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FMZClient* Client = GetMZClient();
+			if (Client && Client->SessionReplayer)
+			{
+				Client->SessionReplayer->Shutdown();
+			}
+		}));
+
+//The table given by the SDK only lives during the callback, so it is packed into a buffer of its own
+template <typename T>
+static flatbuffers::DetachedBuffer PackTable(T const& Table)
+{
+	typename T::NativeTableType Native;
+	Table.UnPackTo(&Native);
+	FMZFlatBufferBuilder fbb;
+	fbb.Finish(T::Pack(fbb, &Native));
+	return fbb.Release();
+}
+
+MZSessionRecorder::~MZSessionRecorder()
+{
+	Stop();
+}
+
+bool MZSessionRecorder::Start(FString const& InFilename)
+{
+	std::unique_lock Lock(Guard);
+	if (WriterThread)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("A session is already being recorded to %s"), *Filename);
+		return false;
+	}
+	FileWriter.Reset(IFileManager::Get().CreateFileWriter(*InFilename));
+	if (!FileWriter)
+	{
+		UE_LOG(LogMZClient, Error, TEXT("MediaZ session could not be recorded to %s"), *InFilename);
+		return false;
+	}
+	Filename = InFilename;
+	uint32 Prolog[2] = { Magic, Version };
+	FileWriter->Serialize(Prolog, sizeof(Prolog));
+	RecordedBytes = sizeof(Prolog);
+	RecordCount = 0;
+	DroppedCount = 0;
+	StartTime = FPlatformTime::Seconds();
+
+	bWriterExit = false;
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	WriterThread = MakeUnique<FThread>(TEXT("MZSessionRecorderThread"), [this]() { RunWriter(); });
+	bRecording = true;
+	UE_LOG(LogMZClient, Display, TEXT("Recording MediaZ session to %s"), *Filename);
+	return true;
+}
+
+bool MZSessionRecorder::Stop()
+{
+	{
+		std::unique_lock Lock(Guard);
+		//the recording may have stopped itself at the size limit, the file still has to be finished
+		if (!WriterThread)
+		{
+			return false;
+		}
+		bRecording = false;
+		SealCurrentChunk();
+	}
+
+	bWriterExit = true;
+	WakeEvent->Trigger();
+	WriterThread->Join();
+	WriterThread.Reset();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+
+	bool bSaved = !FileWriter->IsError();
+	bSaved = FileWriter->Close() && bSaved;
+	FileWriter.Reset();
+	FreeChunks.Empty();
+
+	if (DroppedCount)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("%llu events were not recorded because the disk could not keep up"), DroppedCount);
+	}
+	if (!bSaved)
+	{
+		UE_LOG(LogMZClient, Error, TEXT("MediaZ session could not be written to %s"), *Filename);
+		return false;
+	}
+	UE_LOG(LogMZClient, Display, TEXT("Recorded %llu events (%lld bytes) to %s"), RecordCount, RecordedBytes, *Filename);
+	return true;
+}
+
+void MZSessionRecorder::SealCurrentChunk()
+{
+	if (!CurrentChunk || !CurrentChunk->Used)
+	{
+		return;
+	}
+	SealedChunks.Add(MoveTemp(CurrentChunk));
+	++PendingChunks;
+	WakeEvent->Trigger();
+}
+
+MZSessionRecorder::FChunk* MZSessionRecorder::GetChunk(int64 RecordSize)
+{
+	if (CurrentChunk && CurrentChunk->Data.Num() - CurrentChunk->Used >= RecordSize)
+	{
+		return CurrentChunk.Get();
+	}
+	SealCurrentChunk();
+	if (PendingChunks >= MaxPendingChunks)
+	{
+		return nullptr;
+	}
+	if (CurrentChunk)
+	{
+		//an empty chunk too small for the record
+		CurrentChunk->Data.SetNumUninitialized(RecordSize);
+	}
+	else if (RecordSize <= RecordChunkSize && !FreeChunks.IsEmpty())
+	{
+		CurrentChunk = FreeChunks.Pop(false);
+	}
+	else
+	{
+		CurrentChunk = MakeUnique<FChunk>();
+		CurrentChunk->Data.SetNumUninitialized(FMath::Max(RecordChunkSize, RecordSize));
+	}
+	CurrentChunk->Used = 0;
+	CurrentChunk->Written = 0;
+	return CurrentChunk.Get();
+}
+
+void MZSessionRecorder::Append(EMZRecordType Type, uint32 PinFrameNumber, bool bReset, TArrayView<uint8 const> Prefix, TArrayView<uint8 const> Payload)
+{
+	FMZRecordHeader Header = {};
+	Header.GameFrame = GFrameCounter;
+	Header.PinFrameNumber = PinFrameNumber;
+	Header.Size = Prefix.Num() + Payload.Num();
+	Header.Type = Type;
+	Header.bReset = bReset;
+	int64 Padding = Align(Header.Size, 8) - Header.Size;
+	int64 RecordSize = sizeof(Header) + Header.Size + Padding;
+
+	std::unique_lock Lock(Guard);
+	if (!bRecording)
+	{
+		return;
+	}
+	if (RecordedBytes + RecordSize > int64(CVarRecordMaxSizeMB.GetValueOnAnyThread()) << 20)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("MediaZ session recording reached mediaz.Record.MaxSizeMB, the rest of the session is not recorded."));
+		bRecording = false;
+		return;
+	}
+	FChunk* Chunk = GetChunk(RecordSize);
+	if (!Chunk)
+	{
+		if (DroppedCount++ == 0)
+		{
+			UE_LOG(LogMZClient, Warning, TEXT("MediaZ session recording falls behind the disk, events are dropped."));
+		}
+		return;
+	}
+	Header.Time = FPlatformTime::Seconds() - StartTime;
+	uint8* Dest = Chunk->Data.GetData() + Chunk->Used;
+	FMemory::Memcpy(Dest, &Header, sizeof(Header));
+	Dest += sizeof(Header);
+	FMemory::Memcpy(Dest, Prefix.GetData(), Prefix.Num());
+	Dest += Prefix.Num();
+	FMemory::Memcpy(Dest, Payload.GetData(), Payload.Num());
+	FMemory::Memzero(Dest + Payload.Num(), Padding);
+	Chunk->Used += RecordSize;
+	RecordedBytes += RecordSize;
+	++RecordCount;
+}
+
+void MZSessionRecorder::WriteChunk(FChunk& Chunk, int64 Used)
+{
+	if (Used > Chunk.Written)
+	{
+		FileWriter->Serialize(Chunk.Data.GetData() + Chunk.Written, Used - Chunk.Written);
+		Chunk.Written = Used;
+	}
+}
+
+void MZSessionRecorder::RunWriter()
+{
+	TArray<TUniquePtr<FChunk>> Sealed;
+	for (;;)
+	{
+		//Stop seals the last chunk before it sets the flag, so the pass after it sees everything
+		bool bExit = bWriterExit.load();
+		FChunk* Current = nullptr;
+		int64 CurrentUsed = 0;
+		{
+			std::unique_lock Lock(Guard);
+			Sealed = MoveTemp(SealedChunks);
+			if (CurrentChunk)
+			{
+				Current = CurrentChunk.Get();
+				CurrentUsed = Current->Used;
+			}
+		}
+
+		//the bytes up to Used do not change anymore and chunks are only recycled from here, so no lock is needed.
+		//A chunk sealed in the meantime is written from where this pass stopped by the next one.
+		for (TUniquePtr<FChunk>& Chunk : Sealed)
+		{
+			WriteChunk(*Chunk, Chunk->Used);
+		}
+		if (Current)
+		{
+			WriteChunk(*Current, CurrentUsed);
+		}
+		//the events are with the OS now, they survive a crash of the process
+		FileWriter->Flush();
+
+		if (!Sealed.IsEmpty())
+		{
+			std::unique_lock Lock(Guard);
+			PendingChunks -= Sealed.Num();
+			for (TUniquePtr<FChunk>& Chunk : Sealed)
+			{
+				if (Chunk->Data.Num() == RecordChunkSize)
+				{
+					FreeChunks.Add(MoveTemp(Chunk));
+				}
+			}
+		}
+		Sealed.Reset();
+
+		if (bExit)
+		{
+			return;
+		}
+		WakeEvent->Wait(FMath::Max(CVarRecordFlushIntervalMs.GetValueOnAnyThread(), 1));
+	}
+}
+
+void MZSessionRecorder::RecordPinValue(mz::fb::UUID const& PinId, uint8_t const* Data, size_t Size, bool bReset, uint32_t FrameNumber)
+{
+	Append(EMZRecordType::PinValueChanged, FrameNumber, bReset, MakeArrayView((uint8 const*)&PinId, sizeof(PinId)), MakeArrayView(Data, Size));
+}
+
+void MZSessionRecorder::RecordNode(EMZRecordType Type, mz::fb::Node const& Node)
+{
+	auto Buffer = PackTable(Node);
+	Append(Type, 0, false, {}, MakeArrayView(Buffer.data(), Buffer.size()));
+}
+
+void MZSessionRecorder::RecordFunctionCall(mz::fb::UUID const& NodeId, mz::fb::Node const& Function)
+{
+	auto Buffer = PackTable(Function);
+	Append(EMZRecordType::FunctionCall, 0, false, MakeArrayView((uint8 const*)&NodeId, sizeof(NodeId)), MakeArrayView(Buffer.data(), Buffer.size()));
+}
+
+void MZSessionRecorder::RecordExecuteAppInfo(mz::app::AppExecuteInfo const& Info)
+{
+	auto Buffer = PackTable(Info);
+	Append(EMZRecordType::ExecuteAppInfo, 0, false, {}, MakeArrayView(Buffer.data(), Buffer.size()));
+}
+
+MZSessionReplayer::MZSessionReplayer(FMZClient* InMZClient)
+	: MZClient(InMZClient)
+{
+}
+
+MZSessionReplayer::~MZSessionReplayer()
+{
+	Shutdown();
+}
+
+bool MZSessionReplayer::Start(FString const& InFilename, bool bInMaxSpeed)
+{
+	if (Thread)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("A session is already being replayed from %s"), *Filename);
+		return false;
+	}
+	if (!MZClient->EventDelegates || !MZClient->ConnectionManager)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("Sessions can be replayed once a world is loaded."));
+		return false;
+	}
+	//events of a live MediaZ would race the replay on the pin queues and interleave with it
+	if (MZClient->ConnectionManager->GetState() == EMZConnectionState::Connected && !FMZLoopbackTransport::IsRequested())
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("Sessions can only be replayed while disconnected from MediaZ or on the loopback transport."));
+		return false;
+	}
+
+	MappedFile = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*InFilename);
+	MappedRegion = MappedFile ? MappedFile->MapRegion() : nullptr;
+	uint32 const* Prolog = MappedRegion ? (uint32 const*)MappedRegion->GetMappedPtr() : nullptr;
+	if (!Prolog || MappedRegion->GetMappedSize() < 8 || Prolog[0] != MZSessionRecorder::Magic || Prolog[1] != MZSessionRecorder::Version)
+	{
+		UE_LOG(LogMZClient, Error, TEXT("%s is not a MediaZ session recording"), *InFilename);
+		delete MappedRegion;
+		delete MappedFile;
+		MappedRegion = nullptr;
+		MappedFile = nullptr;
+		return false;
+	}
+
+	Filename = InFilename;
+	bMaxSpeed = bInMaxSpeed;
+	DispatchedCount = 0;
+	FrameCosts.Reset();
+	bExit = false;
+	ReplayThreadId = 0;
+	bReplaying = true;
+	MZClient->ConnectionManager->SetSuspended(true);
+	Thread = FRunnableThread::Create(this, TEXT("MZSessionReplayThread"));
+	return true;
+}
+
+void MZSessionReplayer::Shutdown()
+{
+	if (!Thread)
+	{
+		return;
+	}
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+	if (MZClient->ConnectionManager)
+	{
+		MZClient->ConnectionManager->SetSuspended(false);
+	}
+	delete MappedRegion;
+	delete MappedFile;
+	MappedRegion = nullptr;
+	MappedFile = nullptr;
+	Report();
+}
+
+void MZSessionReplayer::Stop()
+{
+	bExit = true;
+}
+
+void MZSessionReplayer::RecordFrameCost(double Seconds)
+{
+	FrameCosts.Add(Seconds * 1e3);
+}
+
+uint32 MZSessionReplayer::Run()
+{
+	ReplayThreadId = FPlatformTLS::GetCurrentThreadId();
+	uint8 const* Data = MappedRegion->GetMappedPtr();
+	int64 Size = MappedRegion->GetMappedSize();
+	int64 Offset = 8;
+	double StartTime = FPlatformTime::Seconds();
+	while (!bExit && Offset + (int64)sizeof(FMZRecordHeader) <= Size)
+	{
+		FMZRecordHeader Header;
+		FMemory::Memcpy(&Header, Data + Offset, sizeof(Header));
+		Offset += sizeof(Header);
+		if (Offset + Header.Size > Size)
+		{
+			UE_LOG(LogMZClient, Warning, TEXT("%s is truncated"), *Filename);
+			break;
+		}
+
+		if (!bMaxSpeed)
+		{
+			double Wait = StartTime + Header.Time - FPlatformTime::Seconds();
+			while (Wait > 0 && !bExit)
+			{
+				FPlatformProcess::Sleep(FMath::Min(Wait, 0.1));
+				Wait = StartTime + Header.Time - FPlatformTime::Seconds();
+			}
+		}
+		if (!Dispatch(Header, Data + Offset))
+		{
+			UE_LOG(LogMZClient, Warning, TEXT("%s has an invalid record at offset %lld, the replay is stopped"), *Filename, Offset - (int64)sizeof(Header));
+			break;
+		}
+		Offset += Align(Header.Size, 8);
+		++DispatchedCount;
+	}
+	bReplaying = false;
+	UE_LOG(LogMZClient, Display, TEXT("Replayed %llu events from %s in %.2f s"), DispatchedCount, *Filename, FPlatformTime::Seconds() - StartTime);
+	return 0;
+}
+
+bool MZSessionReplayer::Dispatch(FMZRecordHeader const& Header, uint8 const* Payload)
+{
+	auto& Delegates = *MZClient->EventDelegates;
+	//records are 8 byte aligned in the mapping so tables can be read in place
+	auto& Id = *(mz::fb::UUID const*)Payload;
+	bool bHasId = Header.Type == EMZRecordType::PinValueChanged || Header.Type == EMZRecordType::FunctionCall;
+	if (bHasId && Header.Size < sizeof(Id))
+	{
+		return false;
+	}
+	//tables are verified before they are read, a truncated or edited log must not send the reads out of bounds
+	uint8 const* Table = bHasId ? Payload + sizeof(Id) : Payload;
+	flatbuffers::Verifier Verifier(Table, Header.Size - (bHasId ? sizeof(Id) : 0));
+	switch (Header.Type)
+	{
+	case EMZRecordType::PinValueChanged:
+		Delegates.OnPinValueChanged(Id, Table, Header.Size - sizeof(Id), Header.bReset, Header.PinFrameNumber);
+		return true;
+	case EMZRecordType::NodeUpdated:
+		if (!Verifier.VerifyBuffer<mz::fb::Node>(nullptr))
+		{
+			return false;
+		}
+		Delegates.OnNodeUpdated(*flatbuffers::GetRoot<mz::fb::Node>(Table));
+		return true;
+	case EMZRecordType::NodeImported:
+		if (!Verifier.VerifyBuffer<mz::fb::Node>(nullptr))
+		{
+			return false;
+		}
+		Delegates.OnNodeImported(*flatbuffers::GetRoot<mz::fb::Node>(Table));
+		return true;
+	case EMZRecordType::FunctionCall:
+		if (!Verifier.VerifyBuffer<mz::fb::Node>(nullptr))
+		{
+			return false;
+		}
+		Delegates.OnFunctionCall(Id, *flatbuffers::GetRoot<mz::fb::Node>(Table));
+		return true;
+	case EMZRecordType::ExecuteAppInfo:
+		if (!Verifier.VerifyBuffer<mz::app::AppExecuteInfo>(nullptr))
+		{
+			return false;
+		}
+		Delegates.OnExecuteAppInfo(flatbuffers::GetRoot<mz::app::AppExecuteInfo>(Table));
+		return true;
+	}
+	return false;
+}
+
+void MZSessionReplayer::Report()
+{
+	if (FrameCosts.IsEmpty())
+	{
+		return;
+	}
+	FrameCosts.Sort();
+	auto Percentile = [this](float P) { return FrameCosts[FMath::Min(FMath::FloorToInt(P * FrameCosts.Num()), FrameCosts.Num() - 1)]; };
+	UE_LOG(LogMZClient, Display, TEXT("Replay of %s: %d frames, MediaZ task cost ms p50 %.3f p95 %.3f p99 %.3f max %.3f"),
+		*Filename, FrameCosts.Num(), Percentile(0.5f), Percentile(0.95f), Percentile(0.99f), FrameCosts.Last());
+	FrameCosts.Reset();
+}
@@ -0,0 +1,160 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZSharedPinMemory.h"
+#include "MZClient.h"
+
+MZSharedPinMemory::~MZSharedPinMemory()
+{
+	Release();
+}
+
+bool MZSharedPinMemory::Create(FString const& InName)
+{
+	if (Region)
+	{
+		return true;
+	}
+	Name = InName.IsEmpty() ? FString::Printf(TEXT("MZSharedPins_%u"), FPlatformProcess::GetCurrentProcessId()) : InName;
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, sizeof(MZSharedPins::Segment));
+	if (!Region)
+	{
+		UE_LOG(LogMZClient, Warning, TEXT("Shared pin memory %s could not be created, pin values will only be received over gRPC."), *Name);
+		return false;
+	}
+	Segment = (MZSharedPins::Segment*)Region->GetAddress();
+	MZSharedPins::InitializeSegment(*Segment);
+	UE_LOG(LogMZClient, Display, TEXT("Shared pin memory %s is created"), *Name);
+	return true;
+}
+
+void MZSharedPinMemory::Release()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+	}
+	Region = nullptr;
+	Segment = nullptr;
+	Readers.Empty();
+	PendingReleases.Empty();
+	DirectoryVersion = 0;
+}
+
+void MZSharedPinMemory::RefreshDirectory()
+{
+	//a sample takes a memcpy to write, the producer is done with it by now
+	PendingReleases.RemoveAllSwap([this](FSlotReader const& Pending)
+		{
+			return !MZSharedPins::IsClaimedBy(Segment->Slots[Pending.SlotIndex], Pending.Token)
+				|| MZSharedPins::ReleaseSlot(*Segment, Pending.SlotIndex, Pending.Token);
+		});
+
+	uint32 Version = Segment->Header.DirectoryVersion.load(std::memory_order_acquire);
+	if (Version == DirectoryVersion)
+	{
+		return;
+	}
+	DirectoryVersion = Version;
+
+	//readers of released slots are dropped, the others keep their position
+	TMap<FGuid, FSlotReader> Claimed;
+	for (uint32 i = 0; i < MZSharedPins::SlotCount; ++i)
+	{
+		auto& Slot = Segment->Slots[i];
+		uint32 State = Slot.State.load(std::memory_order_acquire);
+		if ((State & MZSharedPins::StateMask) < MZSharedPins::Active)
+		{
+			continue;
+		}
+		uint32 Token = MZSharedPins::GetToken(State);
+		FGuid PinId;
+		FMemory::Memcpy(&PinId, Slot.PinId, sizeof(PinId));
+		if (!MZSharedPins::IsClaimedBy(Slot, Token))
+		{
+			continue;
+		}
+		FSlotReader* Reader = Readers.Find(PinId);
+		if (Reader && Reader->SlotIndex == i && Reader->Token == Token)
+		{
+			Claimed.Add(PinId, *Reader);
+			continue;
+		}
+		//start from the newest value the producer has written so far
+		uint64 WriteCount = Slot.WriteCount.load(std::memory_order_acquire);
+		Claimed.Add(PinId, { .SlotIndex = i, .Token = Token, .ReadCount = WriteCount ? WriteCount - 1 : 0 });
+	}
+	Readers = MoveTemp(Claimed);
+}
+
+void MZSharedPinMemory::ReleasePin(FGuid const& PinId)
+{
+	if (!Segment)
+	{
+		return;
+	}
+	RefreshDirectory();
+	FSlotReader Reader;
+	if (!Readers.RemoveAndCopyValue(PinId, Reader))
+	{
+		return;
+	}
+	if (!MZSharedPins::ReleaseSlot(*Segment, Reader.SlotIndex, Reader.Token) && MZSharedPins::IsClaimedBy(Segment->Slots[Reader.SlotIndex], Reader.Token))
+	{
+		PendingReleases.Add(Reader);
+	}
+}
+
+bool MZSharedPinMemory::Read(FGuid const& PinId, uint32 FrameNumber, bool bFrameOrdered, TArray<uint8>& OutValue, uint32& OutFrameNumber)
+{
+	if (!Segment)
+	{
+		return false;
+	}
+	RefreshDirectory();
+	FSlotReader* Reader = Readers.Find(PinId);
+	if (!Reader)
+	{
+		return false;
+	}
+
+	auto& Slot = Segment->Slots[Reader->SlotIndex];
+	uint64 WriteCount = Slot.WriteCount.load(std::memory_order_acquire);
+	if (WriteCount == Reader->ReadCount || !MZSharedPins::IsClaimedBy(Slot, Reader->Token))
+	{
+		return false;
+	}
+
+	OutValue.SetNumUninitialized(MZSharedPins::MaxValueSize, false);
+	uint32 Size = 0;
+	uint64 Oldest = FMath::Max(Reader->ReadCount, WriteCount > MZSharedPins::RingSize ? WriteCount - MZSharedPins::RingSize : 0);
+	if (bFrameOrdered)
+	{
+		for (uint64 Index = Oldest; Index < WriteCount; ++Index)
+		{
+			if (MZSharedPins::Read(Slot, Index, OutValue.GetData(), Size, OutFrameNumber) && OutFrameNumber == FrameNumber
+				&& MZSharedPins::IsClaimedBy(Slot, Reader->Token))
+			{
+				Reader->ReadCount = Index + 1;
+				OutValue.SetNum(Size, false);
+				return true;
+			}
+		}
+		return false;
+	}
+	//newest sample that can be read without tearing
+	for (uint64 Index = WriteCount; Index-- > Oldest;)
+	{
+		if (MZSharedPins::Read(Slot, Index, OutValue.GetData(), Size, OutFrameNumber))
+		{
+			//the slot may have gone to another pin while the sample was copied
+			if (!MZSharedPins::IsClaimedBy(Slot, Reader->Token))
+			{
+				return false;
+			}
+			Reader->ReadCount = WriteCount;
+			OutValue.SetNum(Size, false);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,55 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZTask.h"
+
+FMZTaskArena& FMZTaskArena::Get()
+{
+	static FMZTaskArena Arena;
+	return Arena;
+}
+
+FMZTaskArena::FMZTaskArena()
+	: Memory(static_cast<uint8*>(FMemory::Malloc(Capacity, PLATFORM_CACHE_LINE_SIZE)))
+{
+}
+
+FMZTaskArena::~FMZTaskArena()
+{
+	FMemory::Free(Memory);
+}
+
+void* FMZTaskArena::Allocate(size_t Size, size_t Alignment)
+{
+	uint64 Current = State.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		uint64 Offset = Align(uint64(uint32(Current)), uint64(Alignment));
+		if (Offset + Size > Capacity)
+		{
+			Allocations.fetch_add(1, std::memory_order_relaxed);
+			HeapFallbacks.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		uint64 Desired = (((Current >> 32) + 1) << 32) | (Offset + Size);
+		if (State.compare_exchange_weak(Current, Desired, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			Allocations.fetch_add(1, std::memory_order_relaxed);
+			return Memory + Offset;
+		}
+	}
+}
+
+void FMZTaskArena::Release()
+{
+	State.fetch_sub(uint64(1) << 32, std::memory_order_acq_rel);
+}
+
+void FMZTaskArena::ResetIfUnused()
+{
+	uint64 Current = State.load(std::memory_order_acquire);
+	//fails if a producer allocated in the meantime, then the arena is rewound on a later frame
+	if ((Current >> 32) == 0 && uint32(Current) != 0)
+	{
+		State.compare_exchange_strong(Current, 0, std::memory_order_acq_rel, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,65 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZTransport.h"
+#include "MZClient.h"
+
+FMZSDKTransport::FMZSDKTransport(FString const& Endpoint, FString const& AppKey)
+{
+	Client = FMediaZ::MakeAppServiceClient(TCHAR_TO_UTF8(*Endpoint), mz::app::ApplicationInfo {
+		.AppKey = TCHAR_TO_UTF8(*AppKey),
+		.AppName = "UE5"
+	});
+}
+
+FMZSDKTransport::~FMZSDKTransport()
+{
+	if (FMediaZ::ShutdownClient)
+	{
+		FMediaZ::ShutdownClient(Client);
+	}
+}
+
+void FMZSDKTransport::RegisterEventDelegates(mz::app::IEventDelegates* EventDelegates)
+{
+	Client->RegisterEventDelegates(EventDelegates);
+}
+
+void FMZSDKTransport::TryConnect()
+{
+	Client->TryConnect();
+}
+
+bool FMZSDKTransport::IsConnected()
+{
+	return Client->IsConnected();
+}
+
+void FMZSDKTransport::Send(mz::app::AppEvent const& Event)
+{
+	Client->Send(Event);
+}
+
+void FMZSDKTransport::SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update)
+{
+	Client->SendPartialNodeUpdate(Update);
+}
+
+void FMZSDKTransport::SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs)
+{
+	Client->SendPinShowAsChange(PinId, ShowAs);
+}
+
+void FMZSDKTransport::SendContextMenuUpdate(mz::ContextMenuUpdate const& Update)
+{
+	Client->SendContextMenuUpdate(Update);
+}
+
+void FMZSDKTransport::NotifyPinValueChanged(mz::PinValueChanged const& Value)
+{
+	Client->NotifyPinValueChanged(Value);
+}
+
+void FMZSDKTransport::UpdateStringList(mz::app::UpdateStringList const& List)
+{
+	Client->UpdateStringList(List);
+}
@@ -0,0 +1,86 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/MemoryBase.h"
+#include <atomic>
+
+// Counts the heap allocations of the calling thread while in scope, for the allocation benchmarks.
+// GMalloc is replaced by a forwarding proxy, other threads keep allocating through it without being counted.
+// The proxy is never destroyed, so memory allocated through it can be freed after the scope ended. Counters do not nest.
+class FMZScopedAllocationCounter
+{
+public:
+	FMZScopedAllocationCounter()
+	{
+		FCountingMalloc& Proxy = GetProxy();
+		check(!Proxy.Inner);
+		Proxy.Inner = GMalloc;
+		Proxy.Count = 0;
+		Proxy.ThreadId = FPlatformTLS::GetCurrentThreadId();
+		GMalloc = &Proxy;
+	}
+
+	~FMZScopedAllocationCounter()
+	{
+		FCountingMalloc& Proxy = GetProxy();
+		Proxy.ThreadId = 0;
+		GMalloc = Proxy.Inner;
+		Proxy.Inner = nullptr;
+	}
+
+	uint64 GetCount() const
+	{
+		return GetProxy().Count.load();
+	}
+
+	//Counts from zero again, e.g. after a warm up
+	void Reset()
+	{
+		GetProxy().Count = 0;
+	}
+
+private:
+	class FCountingMalloc : public FMalloc
+	{
+	public:
+		FMalloc* Inner = nullptr;
+		std::atomic<uint32> ThreadId = 0;
+		std::atomic<uint64> Count = 0;
+
+		virtual void* Malloc(SIZE_T Size, uint32 Alignment) override
+		{
+			CountCaller();
+			return Inner->Malloc(Size, Alignment);
+		}
+		virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override
+		{
+			CountCaller();
+			return Inner->Realloc(Original, Size, Alignment);
+		}
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override { return Inner->QuantizeSize(Size, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		void CountCaller()
+		{
+			if (ThreadId.load(std::memory_order_relaxed) == FPlatformTLS::GetCurrentThreadId())
+			{
+				Count.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	static FCountingMalloc& GetProxy()
+	{
+		static FCountingMalloc* Proxy = new FCountingMalloc();
+		return *Proxy;
+	}
+};
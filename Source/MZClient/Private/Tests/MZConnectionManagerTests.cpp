@@ -0,0 +1,120 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZConnectionManager.h"
+#include "MZScopedCVarValue.h"
+#include <atomic>
+
+// Drives the connection thread against a stand-in MediaZ that refuses, accepts and drops connections.
+
+namespace
+{
+	class FMZFakeServerTransport : public IMZTransport
+	{
+	public:
+		std::atomic<bool> bAccept = false;
+		std::atomic<bool> bConnected = false;
+
+		virtual void RegisterEventDelegates(mz::app::IEventDelegates* EventDelegates) override {}
+		virtual void TryConnect() override { bConnected = bAccept.load(); }
+		virtual bool IsConnected() override { return bConnected; }
+
+		virtual void Send(mz::app::AppEvent const& Event) override {}
+		virtual void SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update) override {}
+		virtual void SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs) override {}
+		virtual void SendContextMenuUpdate(mz::ContextMenuUpdate const& Update) override {}
+		virtual void NotifyPinValueChanged(mz::PinValueChanged const& Value) override {}
+		virtual void UpdateStringList(mz::app::UpdateStringList const& List) override {}
+	};
+
+	//The connection thread runs on its own, the test thread polls for the state it should reach
+	bool WaitFor(TFunctionRef<bool()> Condition, double TimeoutSeconds = 5.0)
+	{
+		double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+		while (!Condition())
+		{
+			if (FPlatformTime::Seconds() > Deadline)
+			{
+				return false;
+			}
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZConnectionManagerTest, "MediaZ.Client.ConnectionManager", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZConnectionManagerTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 InitialDelayMs = 8;
+	constexpr int32 MaxDelayMs = 64;
+	FScopedCVarValue InitialDelay(TEXT("mediaz.Reconnect.InitialDelayMs"), InitialDelayMs);
+	FScopedCVarValue MaxDelay(TEXT("mediaz.Reconnect.MaxDelayMs"), MaxDelayMs);
+	FScopedCVarValue PollInterval(TEXT("mediaz.Reconnect.PollIntervalMs"), 5);
+
+	//the delay doubles once every endpoint failed, up to the maximum, and the jitter keeps it between half and all of it
+	FRandomStream Jitter(1234);
+	for (int32 EndpointCount = 1; EndpointCount <= 3; ++EndpointCount)
+	{
+		uint32 OutOfBounds = 0;
+		int64 SmallestAtMax = MaxDelayMs;
+		int64 LargestAtMax = 0;
+		for (uint32 Failed = 1; Failed <= 16; ++Failed)
+		{
+			int64 Expected = FMath::Min<int64>((int64)InitialDelayMs << (Failed / EndpointCount), MaxDelayMs);
+			for (int32 Sample = 0; Sample < 200; ++Sample)
+			{
+				int64 DelayMs = MZConnectionManager::GetBackoffDelayMs(Failed, EndpointCount, Jitter);
+				OutOfBounds += DelayMs < Expected / 2 || DelayMs > Expected;
+				if (Expected == MaxDelayMs)
+				{
+					SmallestAtMax = FMath::Min(SmallestAtMax, DelayMs);
+					LargestAtMax = FMath::Max(LargestAtMax, DelayMs);
+				}
+			}
+		}
+		TestEqual(FString::Printf(TEXT("%d endpoints: backoff delays out of bounds"), EndpointCount), OutOfBounds, 0u);
+		TestTrue(FString::Printf(TEXT("%d endpoints: capped delays are jittered"), EndpointCount), SmallestAtMax < LargestAtMax);
+	}
+
+	MZConnectionManager Manager;
+	FMZFakeServerTransport* Server = new FMZFakeServerTransport();
+	TArray<TUniquePtr<IMZTransport>> Transports;
+	Transports.Add(TUniquePtr<IMZTransport>(Server));
+	Manager.Start(MoveTemp(Transports), { TEXT("fake") });
+
+	//refused: retried with backoff and never reported as connected
+	bool bConnectedWhileRefusing = false;
+	TestTrue(TEXT("Refused connections are retried"), WaitFor([&]()
+		{
+			bConnectedWhileRefusing |= Manager.GetState() == EMZConnectionState::Connected;
+			return Manager.ConnectAttempts.load() >= 5;
+		}));
+	TestFalse(TEXT("Not connected while refused"), bConnectedWhileRefusing);
+	TestNull(TEXT("No active client while refused"), Manager.GetActiveClient());
+
+	//accepted
+	Server->bAccept = true;
+	TestTrue(TEXT("Connects once accepted"), WaitFor([&]() { return Manager.GetState() == EMZConnectionState::Connected; }));
+	TestTrue(TEXT("Active client is the accepting transport"), Manager.GetActiveClient() == Server);
+
+	//dropped: a new attempt is made right after the backoff and connects again
+	uint32 AttemptsBeforeDrop = Manager.ConnectAttempts.load();
+	Server->bConnected = false;
+	Manager.NotifyConnectionClosed();
+	TestTrue(TEXT("Reconnects after a drop"), WaitFor([&]()
+		{
+			return Manager.ConnectAttempts.load() > AttemptsBeforeDrop && Manager.GetState() == EMZConnectionState::Connected;
+		}));
+
+	Manager.Shutdown();
+	TestTrue(TEXT("Disconnected after shutdown"), Manager.GetState() == EMZConnectionState::Disconnected);
+	return true;
+}
+
+#endif
@@ -0,0 +1,135 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZClient.h"
+#include "MZConsoleForwarder.h"
+#include "MZLoopbackTransport.h"
+#include "MZScopedCVarValue.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Run them with "Automation RunTests MediaZ.Client.ConsoleForwarder", ideally on a build with many cores.
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZConsoleForwarderRingTest, "MediaZ.Client.ConsoleForwarder.Mpmc", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZConsoleForwarderRingTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Producers = 4;
+	constexpr uint32 Consumers = 2;
+	constexpr uint32 LinesPerProducer = 50000;
+
+	//the thread is never started, the test drives the ring directly
+	MZConsoleForwarder Forwarder(nullptr);
+	std::vector<std::atomic<uint32>> Received(Producers * LinesPerProducer);
+	std::atomic<uint32> Corrupted = 0;
+	std::atomic<uint32> Popped = 0;
+
+	std::vector<std::thread> Threads;
+	for (uint32 P = 0; P < Producers; ++P)
+	{
+		Threads.emplace_back([&Forwarder, P]()
+			{
+				for (uint32 i = 0; i < LinesPerProducer; ++i)
+				{
+					//variable length lines with a checkable body
+					uint32 Id = P * LinesPerProducer + i;
+					std::string Line = std::to_string(Id) + ':' + std::string(Id % 400, char('a' + Id % 26));
+					while (!Forwarder.TryPush(Line.data(), uint32(Line.size())))
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+	}
+	for (uint32 C = 0; C < Consumers; ++C)
+	{
+		Threads.emplace_back([&]()
+			{
+				std::string Line;
+				while (Popped.load(std::memory_order_relaxed) < Producers * LinesPerProducer)
+				{
+					Line.clear();
+					if (!Forwarder.TryPop(Line))
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					Popped.fetch_add(1, std::memory_order_relaxed);
+
+					size_t Colon = Line.find(':');
+					uint32 Id = Colon == std::string::npos ? UINT32_MAX : uint32(std::strtoul(Line.c_str(), nullptr, 10));
+					if (Id >= Producers * LinesPerProducer || Line != std::to_string(Id) + ':' + std::string(Id % 400, char('a' + Id % 26)))
+					{
+						Corrupted.fetch_add(1, std::memory_order_relaxed);
+						continue;
+					}
+					Received[Id].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+	}
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	uint32 NotExactlyOnce = 0;
+	for (std::atomic<uint32>& Count : Received)
+	{
+		NotExactlyOnce += Count.load() != 1;
+	}
+	TestEqual(TEXT("Corrupted lines"), Corrupted.load(), 0u);
+	TestEqual(TEXT("Lines not received exactly once"), NotExactlyOnce, 0u);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZConsoleForwarderBenchmark, "MediaZ.Client.ConsoleForwarder.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FMZConsoleForwarderBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Lines = 100000;
+	FName const Category(TEXT("LogMZBenchmark"));
+	FString const Line = TEXT("LogMZBenchmark: Display: Actor BP_Camera_C_3 moved to (X=1024.000 Y=-512.250 Z=128.500) on frame 123456");
+
+	//what Serialize did before the forwarder: build and send one event per line on the logging thread.
+	//The loopback transport does not send anything, so this is a lower bound of the old cost.
+	FMZLoopbackTransport Transport;
+	Transport.SetRecordOutbound(false);
+	uint64 Start = FPlatformTime::Cycles64();
+	for (uint32 i = 0; i < Lines; ++i)
+	{
+		flatbuffers::FlatBufferBuilder mb;
+		auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateConsoleOutputDirect(mb, TCHAR_TO_UTF8(*Line)));
+		mb.Finish(offset);
+		auto buf = mb.Release();
+		auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
+		Transport.Send(*root);
+	}
+	double LegacyNs = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Start) * 1e9 / Lines;
+
+	//without the rate limit every line reaches the ring, the forwarder thread drains it as fast as it can
+	FScopedCVarValue MaxLinesPerSecond(TEXT("mediaz.ConsoleForward.MaxLinesPerSecond"), 0);
+	FScopedCVarValue FlushInterval(TEXT("mediaz.ConsoleForward.FlushIntervalMs"), 1);
+	MZConsoleForwarder Forwarder(nullptr);
+	Forwarder.Start();
+	MZConsoleOutput Output(&Forwarder);
+	Start = FPlatformTime::Cycles64();
+	for (uint32 i = 0; i < Lines; ++i)
+	{
+		Output.Serialize(*Line, ELogVerbosity::Display, Category);
+	}
+	double ForwarderNs = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Start) * 1e9 / Lines;
+	Forwarder.Shutdown();
+
+	AddInfo(FString::Printf(TEXT("Caller side cost of %u console lines"), Lines));
+	AddInfo(FString::Printf(TEXT("Send per line:            %.1f ns"), LegacyNs));
+	AddInfo(FString::Printf(TEXT("MZConsoleOutput to ring:  %.1f ns"), ForwarderNs));
+	AddInfo(FString::Printf(TEXT("Events the old path sent: %llu"), Transport.OutboundCount.load()));
+	return true;
+}
+
+#endif
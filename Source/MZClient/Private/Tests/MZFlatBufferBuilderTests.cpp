@@ -0,0 +1,102 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZFlatBufferBuilder.h"
+#include "MZAllocationCounter.h"
+#include <vector>
+
+namespace
+{
+	struct FBuilderBenchmarkResult
+	{
+		double AllocationsPerMessage = 0;
+		double NsPerMessage = 0;
+		size_t Size = 0;
+	};
+
+	//Builds, finishes and releases the same message like the senders do, after a warm up so the thread cache is filled
+	template <typename BuilderType>
+	FBuilderBenchmarkResult RunBuilderBenchmark(uint32 Messages, TFunctionRef<void(flatbuffers::FlatBufferBuilder&)> Build)
+	{
+		FBuilderBenchmarkResult Result;
+		auto BuildOne = [&Build, &Result]()
+			{
+				BuilderType mb;
+				Build(mb);
+				auto buf = mb.Release();
+				Result.Size = buf.size();
+			};
+		for (uint32 i = 0; i < 100; ++i)
+		{
+			BuildOne();
+		}
+
+		FMZScopedAllocationCounter Counter;
+		uint64 Start = FPlatformTime::Cycles64();
+		for (uint32 i = 0; i < Messages; ++i)
+		{
+			BuildOne();
+		}
+		Result.NsPerMessage = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Start) * 1e9 / Messages;
+		Result.AllocationsPerMessage = double(Counter.GetCount()) / Messages;
+		return Result;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZFlatBufferBuilderBenchmark, "MediaZ.Client.FlatBufferBuilder.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FMZFlatBufferBuilderBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Messages = 20000;
+	constexpr uint32 PinsPerNode = 32;
+
+	FGuid NodeId(1, 2, 3, 4);
+	TArray<FGuid> PinIds;
+	for (uint32 i = 0; i < PinsPerNode; ++i)
+	{
+		PinIds.Add(FGuid(i, 1, 2, 3));
+	}
+	//a transform, the most common pin value
+	std::vector<uint8_t> Value(sizeof(double) * 9, 1);
+	std::vector<flatbuffers::Offset<mz::fb::Pin>> GraphPins;
+	GraphPins.reserve(PinsPerNode);
+
+	//what SendPinUpdate sends for a node with PinsPerNode property pins
+	auto BuildNodeUpdate = [&](flatbuffers::FlatBufferBuilder& mb)
+		{
+			GraphPins.clear();
+			for (FGuid const& PinId : PinIds)
+			{
+				GraphPins.push_back(mz::fb::CreatePinDirect(mb, (mz::fb::UUID*)&PinId, "Relative Location", "mz.fb.vec3d", mz::fb::ShowAs::PROPERTY, mz::fb::CanShowAs::INPUT_OUTPUT_PROPERTY, "UE PROPERTY", 0, &Value));
+			}
+			mb.Finish(mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&NodeId, mz::ClearFlags::CLEAR_PINS, 0, &GraphPins, 0, 0, 0, 0));
+		};
+	//what SendPinValueChanged sends for one property
+	auto BuildPinValue = [&](flatbuffers::FlatBufferBuilder& mb)
+		{
+			mb.Finish(mz::CreatePinValueChangedDirect(mb, (mz::fb::UUID*)&PinIds[0], &Value));
+		};
+
+	FBuilderBenchmarkResult NodeDefault = RunBuilderBenchmark<flatbuffers::FlatBufferBuilder>(Messages, BuildNodeUpdate);
+	FBuilderBenchmarkResult NodePooled = RunBuilderBenchmark<FMZFlatBufferBuilder>(Messages, BuildNodeUpdate);
+	FBuilderBenchmarkResult PinDefault = RunBuilderBenchmark<flatbuffers::FlatBufferBuilder>(Messages, BuildPinValue);
+	FBuilderBenchmarkResult PinPooled = RunBuilderBenchmark<FMZFlatBufferBuilder>(Messages, BuildPinValue);
+
+	auto Report = [this](TCHAR const* Name, FBuilderBenchmarkResult const& Default, FBuilderBenchmarkResult const& Pooled)
+		{
+			AddInfo(FString::Printf(TEXT("%s (%llu bytes): FlatBufferBuilder %.2f allocations %.1f ns, FMZFlatBufferBuilder %.2f allocations %.1f ns"),
+				Name, uint64(Pooled.Size), Default.AllocationsPerMessage, Default.NsPerMessage, Pooled.AllocationsPerMessage, Pooled.NsPerMessage));
+		};
+	Report(TEXT("PartialNodeUpdate"), NodeDefault, NodePooled);
+	Report(TEXT("PinValueChanged"), PinDefault, PinPooled);
+
+	TestEqual(TEXT("PartialNodeUpdate allocations once warm"), NodePooled.AllocationsPerMessage, 0.0);
+	TestEqual(TEXT("PinValueChanged allocations once warm"), PinPooled.AllocationsPerMessage, 0.0);
+	return true;
+}
+
+#endif
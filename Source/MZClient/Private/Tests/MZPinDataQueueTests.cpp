@@ -0,0 +1,252 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZPinDataQueue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Run them with "Automation RunTests MediaZ.Client.PinDataQueue", ideally on a build with many cores.
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZPinDataQueueSpscTest, "MediaZ.Client.PinDataQueue.Spsc", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZPinDataQueueSpscTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32_t Frames = 200000;
+	PinDataQueue Queue(16, TEXT("SpscTest"));
+	std::atomic<uint32_t> Consumed = 0;
+
+	//the payload repeats the frame number so a torn or stale slot shows up as a mismatch,
+	//the producer stays within the ring so every value has to arrive
+	std::thread Producer([&Queue, &Consumed]()
+		{
+			for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+			{
+				while (Frame - Consumed.load(std::memory_order_relaxed) > Queue.GetCapacity())
+				{
+					std::this_thread::yield();
+				}
+				uint32_t Value[4] = { Frame, Frame, Frame, Frame };
+				Queue.Enqueue(MZPinPayload(reinterpret_cast<uint8_t const*>(Value), sizeof(Value)), Frame);
+			}
+		});
+
+	uint32_t Mismatches = 0;
+	uint32_t Missing = 0;
+	for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+	{
+		PinDataQueue::Sample const* Sample = Queue.DiscardExcessThenDequeue(Frame, true, FPlatformTime::Seconds() + 5.0);
+		Consumed.store(Frame, std::memory_order_relaxed);
+		if (!Sample)
+		{
+			Missing++;
+			continue;
+		}
+		uint32_t const* Value = reinterpret_cast<uint32_t const*>(Sample->Payload.Data());
+		if (Sample->FrameNumber != Frame || Sample->Payload.Size() != 4 * sizeof(uint32_t)
+			|| Value[0] != Frame || Value[1] != Frame || Value[2] != Frame || Value[3] != Frame)
+		{
+			Mismatches++;
+		}
+	}
+	Producer.join();
+
+	TestEqual(TEXT("Samples not received"), Missing, 0u);
+	TestEqual(TEXT("Samples out of order or torn"), Mismatches, 0u);
+	TestEqual(TEXT("Overruns"), Queue.Overruns.load(), uint64(0));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZPinDataQueueOverrunTest, "MediaZ.Client.PinDataQueue.Overrun", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZPinDataQueueOverrunTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32_t Frames = 200000;
+	PinDataQueue Queue(4, TEXT("OverrunTest"));
+	std::atomic<bool> bDone = false;
+
+	//the producer never waits, so the consumer keeps falling behind by a full ring and racing it for the oldest value
+	std::thread Producer([&Queue, &bDone]()
+		{
+			for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+			{
+				uint32_t Value[4] = { Frame, Frame, Frame, Frame };
+				Queue.Enqueue(MZPinPayload(reinterpret_cast<uint8_t const*>(Value), sizeof(Value)), Frame);
+			}
+			bDone = true;
+		});
+
+	uint32_t Received = 0;
+	uint32_t Mismatches = 0;
+	uint32_t LastFrame = 0;
+	for (;;)
+	{
+		bool bProducerDone = bDone.load();
+		while (Queue.Dequeue())
+		{
+			PinDataQueue::Sample const& Sample = Queue.Latest;
+			uint32_t Frame = Sample.FrameNumber;
+			uint32_t const* Value = reinterpret_cast<uint32_t const*>(Sample.Payload.Data());
+			if (Frame <= LastFrame || Sample.Payload.Size() != 4 * sizeof(uint32_t)
+				|| Value[0] != Frame || Value[1] != Frame || Value[2] != Frame || Value[3] != Frame)
+			{
+				Mismatches++;
+			}
+			LastFrame = Frame;
+			Received++;
+		}
+		if (bProducerDone)
+		{
+			break;
+		}
+	}
+	Producer.join();
+
+	TestEqual(TEXT("Samples out of order or torn"), Mismatches, 0u);
+	TestEqual(TEXT("Every value is either received or counted as overrun"), uint64(Received) + Queue.Overruns.load(), uint64(Frames));
+	TestEqual(TEXT("The newest value is kept"), LastFrame, Frames);
+	return true;
+}
+
+namespace
+{
+	constexpr uint32 BenchmarkPins = 200;
+	constexpr uint32 BenchmarkRateHz = 1000;
+	constexpr uint32 BenchmarkTicks = 3000;
+	constexpr double BenchmarkFrameSeconds = 1.0 / 60.0;
+
+	struct FPinQueueBenchmarkResult
+	{
+		double EnqueueNs = 0;
+		double DrainNs = 0;
+		uint64 Values = 0;
+		uint64 Drains = 0;
+		uint64 Received = 0;
+	};
+
+	//The gRPC thread pushes a value to every pin at BenchmarkRateHz, the game thread drains every pin once a 60 Hz frame.
+	//Only the time spent inside the queue calls is measured, the pacing is not.
+	FPinQueueBenchmarkResult RunPinQueueBenchmark(TFunctionRef<void(uint32 Pin, uint8_t const* Data, size_t Size, uint32_t Frame)> Enqueue,
+		TFunctionRef<bool(uint32 Pin, uint32_t Frame)> Drain)
+	{
+		FPinQueueBenchmarkResult Result;
+		std::atomic<uint32_t> PublishedTick = 0;
+		std::atomic<uint64> EnqueueCycles = 0;
+
+		std::thread Producer([&]()
+			{
+				//a transform sized value
+				uint8_t Value[128] = {};
+				uint64 Cycles = 0;
+				double Next = FPlatformTime::Seconds();
+				for (uint32_t Tick = 1; Tick <= BenchmarkTicks; ++Tick)
+				{
+					while (FPlatformTime::Seconds() < Next)
+					{
+						std::this_thread::yield();
+					}
+					Next += 1.0 / BenchmarkRateHz;
+
+					std::memcpy(Value, &Tick, sizeof(Tick));
+					uint64 Start = FPlatformTime::Cycles64();
+					for (uint32 Pin = 0; Pin < BenchmarkPins; ++Pin)
+					{
+						Enqueue(Pin, Value, sizeof(Value), Tick);
+					}
+					Cycles += FPlatformTime::Cycles64() - Start;
+					PublishedTick.store(Tick, std::memory_order_release);
+				}
+				EnqueueCycles = Cycles;
+			});
+
+		uint64 DrainCycles = 0;
+		uint32_t LastDrained = 0;
+		while (LastDrained < BenchmarkTicks)
+		{
+			FPlatformProcess::Sleep(BenchmarkFrameSeconds);
+			uint32_t Tick = PublishedTick.load(std::memory_order_acquire);
+			if (Tick == LastDrained)
+			{
+				continue;
+			}
+			uint64 Start = FPlatformTime::Cycles64();
+			for (uint32 Pin = 0; Pin < BenchmarkPins; ++Pin)
+			{
+				Result.Received += Drain(Pin, Tick);
+			}
+			DrainCycles += FPlatformTime::Cycles64() - Start;
+			Result.Drains++;
+			LastDrained = Tick;
+		}
+		Producer.join();
+
+		Result.Values = uint64(BenchmarkTicks) * BenchmarkPins;
+		Result.EnqueueNs = FPlatformTime::ToSeconds64(EnqueueCycles.load()) * 1e9 / Result.Values;
+		Result.DrainNs = FPlatformTime::ToSeconds64(DrainCycles) * 1e9 / (Result.Drains * BenchmarkPins);
+		return Result;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZPinDataQueueBenchmark, "MediaZ.Client.PinDataQueue.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FMZPinDataQueueBenchmark::RunTest(const FString& Parameters)
+{
+	//the queue the plugin used before, one heap copy and one linked list node per value
+	typedef TQueue<TPair<mz::Buffer, uint32_t>> FLegacyPinQueue;
+	std::unique_ptr<FLegacyPinQueue[]> LegacyQueues = std::make_unique<FLegacyPinQueue[]>(BenchmarkPins);
+	FPinQueueBenchmarkResult Legacy = RunPinQueueBenchmark(
+		[&LegacyQueues](uint32 Pin, uint8_t const* Data, size_t Size, uint32_t Frame)
+		{
+			LegacyQueues[Pin].Enqueue({ mz::Buffer(Data, Size), Frame });
+		},
+		[&LegacyQueues](uint32 Pin, uint32_t Frame)
+		{
+			TPair<mz::Buffer, uint32_t> Result;
+			bool bDequeued = false;
+			while (LegacyQueues[Pin].Dequeue(Result))
+			{
+				bDequeued = true;
+				if (Result.Value >= Frame)
+				{
+					break;
+				}
+			}
+			return bDequeued;
+		});
+
+	std::vector<std::unique_ptr<PinDataQueue>> Queues;
+	for (uint32 Pin = 0; Pin < BenchmarkPins; ++Pin)
+	{
+		Queues.push_back(std::make_unique<PinDataQueue>(64, FString::Printf(TEXT("Benchmark%u"), Pin)));
+	}
+	FPinQueueBenchmarkResult Ring = RunPinQueueBenchmark(
+		[&Queues](uint32 Pin, uint8_t const* Data, size_t Size, uint32_t Frame)
+		{
+			//the gRPC thread copies each value once and every registration of the pin shares it
+			Queues[Pin]->Enqueue(MZPinPayload(Data, Size), Frame);
+		},
+		[&Queues](uint32 Pin, uint32_t Frame)
+		{
+			return Queues[Pin]->DiscardExcessThenDequeue(Frame, false, 0) != nullptr;
+		});
+
+	uint64 Overruns = 0;
+	for (auto& Queue : Queues)
+	{
+		Overruns += Queue->Overruns.load();
+	}
+
+	AddInfo(FString::Printf(TEXT("%u pins at %u Hz, drained at 60 Hz"), BenchmarkPins, BenchmarkRateHz));
+	AddInfo(FString::Printf(TEXT("TQueue:       %.1f ns per enqueue, %.1f ns per pin drain"), Legacy.EnqueueNs, Legacy.DrainNs));
+	AddInfo(FString::Printf(TEXT("PinDataQueue: %.1f ns per enqueue, %.1f ns per pin drain, %llu overruns"), Ring.EnqueueNs, Ring.DrainNs, Overruns));
+
+	//timings depend on the machine, only the delivery is checked
+	TestEqual(TEXT("Every drain found a value"), Ring.Received, Ring.Drains * BenchmarkPins);
+	return true;
+}
+
+#endif
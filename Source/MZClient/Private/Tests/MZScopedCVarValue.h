@@ -0,0 +1,30 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+
+// Sets an integer console variable for the duration of a test and restores the previous value afterwards
+struct FScopedCVarValue
+{
+	IConsoleVariable* Var;
+	int32 Previous;
+
+	FScopedCVarValue(TCHAR const* Name, int32 Value)
+		: Var(IConsoleManager::Get().FindConsoleVariable(Name))
+		, Previous(Var ? Var->GetInt() : 0)
+	{
+		if (Var)
+		{
+			Var->Set(Value, ECVF_SetByCode);
+		}
+	}
+	~FScopedCVarValue()
+	{
+		if (Var)
+		{
+			Var->Set(Previous, ECVF_SetByCode);
+		}
+	}
+};
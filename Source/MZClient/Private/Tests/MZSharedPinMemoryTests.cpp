@@ -0,0 +1,249 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZSharedPinMemory.h"
+#include <atomic>
+#include <thread>
+
+// Run them with "Automation RunTests MediaZ.Client.SharedPinMemory", ideally on a build with many cores.
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZSharedPinSeqlockTest, "MediaZ.Client.SharedPinMemory.Seqlock", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZSharedPinSeqlockTest::RunTest(const FString& Parameters)
+{
+	using namespace MZSharedPins;
+	constexpr uint32_t Frames = 500000;
+
+	TUniquePtr<Segment> Seg = MakeUnique<Segment>();
+	InitializeSegment(*Seg);
+	uint8_t PinId[16] = { 1 };
+	uint32_t Token = 0;
+	int32_t SlotIndex = ClaimSlot(*Seg, PinId, Token);
+	TestEqual(TEXT("Claimed slot"), SlotIndex, 0);
+	uint32_t SameToken = 0;
+	TestEqual(TEXT("Claiming again returns the same slot"), ClaimSlot(*Seg, PinId, SameToken), SlotIndex);
+	TestEqual(TEXT("Claiming again returns the same token"), SameToken, Token);
+	Slot& S = Seg->Slots[SlotIndex];
+
+	//every byte of a sample is derived from its frame number, sizes vary so stale tails are caught too
+	std::thread Producer([&S, Token]()
+		{
+			uint8_t Data[MaxValueSize];
+			for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+			{
+				uint32_t Size = 1 + Frame % MaxValueSize;
+				std::memset(Data, uint8_t(Frame), Size);
+				Write(S, Token, Data, Size, Frame);
+			}
+		});
+
+	uint8_t Data[MaxValueSize];
+	uint32_t Reads = 0;
+	uint32_t Torn = 0;
+	uint32_t LastFrame = 0;
+	uint32_t Backwards = 0;
+	while (S.WriteCount.load(std::memory_order_acquire) < Frames)
+	{
+		uint64_t Count = S.WriteCount.load(std::memory_order_acquire);
+		if (Count == 0)
+		{
+			continue;
+		}
+		uint32_t Size = 0;
+		uint32_t Frame = 0;
+		if (!Read(S, Count - 1, Data, Size, Frame))
+		{
+			continue;
+		}
+		Reads++;
+		bool bValid = Size == 1 + Frame % MaxValueSize;
+		for (uint32_t i = 0; bValid && i < Size; ++i)
+		{
+			bValid = Data[i] == uint8_t(Frame);
+		}
+		Torn += !bValid;
+		Backwards += Frame < LastFrame;
+		LastFrame = Frame;
+	}
+	Producer.join();
+
+	TestTrue(TEXT("Some reads succeeded"), Reads > 0);
+	TestEqual(TEXT("Torn samples accepted"), Torn, 0u);
+	TestEqual(TEXT("Samples older than an earlier read"), Backwards, 0u);
+
+	//a sample the producer has lapped must be rejected
+	uint32_t Size = 0;
+	uint32_t Frame = 0;
+	TestFalse(TEXT("Overwritten sample is rejected"), Read(S, 0, Data, Size, Frame));
+	TestTrue(TEXT("Newest sample is accepted"), Read(S, Frames - 1, Data, Size, Frame) && Frame == Frames);
+	return true;
+}
+
+namespace
+{
+	constexpr uint32 StandInPins = 4;
+
+	FGuid GetStandInPinId(uint32 Pin)
+	{
+		return FGuid(0x4D5A5350, Pin, 0, 1);
+	}
+
+	//Producers outside of Unreal open the segment by the name published in the root node metadata
+	struct FStandInProducer
+	{
+		FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+		MZSharedPins::Segment* Seg = nullptr;
+
+		explicit FStandInProducer(FString const& Name)
+		{
+			Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, false, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, sizeof(MZSharedPins::Segment));
+			Seg = Region ? (MZSharedPins::Segment*)Region->GetAddress() : nullptr;
+		}
+		~FStandInProducer()
+		{
+			if (Region)
+			{
+				FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+			}
+		}
+
+		int32_t Claim(FGuid const& PinId, uint32_t& OutToken)
+		{
+			return MZSharedPins::ClaimSlot(*Seg, (uint8_t const*)&PinId, OutToken);
+		}
+
+		bool Write(int32_t SlotIndex, uint32_t Token, uint32 Pin, uint32_t Frame)
+		{
+			uint32_t Value[4] = { Pin, Frame, Frame, Frame };
+			return MZSharedPins::Write(Seg->Slots[SlotIndex], Token, Value, sizeof(Value), Frame);
+		}
+	};
+
+	bool IsStandInValue(TArray<uint8> const& Value, uint32 Pin, uint32 Frame)
+	{
+		uint32 const* Words = (uint32 const*)Value.GetData();
+		return Value.Num() == 4 * sizeof(uint32) && Words[0] == Pin && Words[1] == Frame && Words[2] == Frame && Words[3] == Frame;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZSharedPinMemoryTest, "MediaZ.Client.SharedPinMemory.Producer", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZSharedPinMemoryTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32 Frames = 20000;
+
+	//its own segment, the client may have created the default one
+	MZSharedPinMemory Consumer;
+	if (!TestTrue(TEXT("Segment created"), Consumer.Create(FString::Printf(TEXT("MZSharedPinsTest_%u"), FPlatformProcess::GetCurrentProcessId()))))
+	{
+		return false;
+	}
+	FStandInProducer Producer(Consumer.GetName());
+	if (!TestNotNull(TEXT("Segment opened by the producer"), Producer.Seg) || !TestEqual(TEXT("Segment magic"), Producer.Seg->Header.Magic, MZSharedPins::Magic))
+	{
+		return false;
+	}
+
+	int32_t Slots[StandInPins];
+	uint32_t Tokens[StandInPins];
+	for (uint32 Pin = 0; Pin < StandInPins; ++Pin)
+	{
+		Slots[Pin] = Producer.Claim(GetStandInPinId(Pin), Tokens[Pin]);
+		TestTrue(FString::Printf(TEXT("Pin %u claimed a slot"), Pin), Slots[Pin] >= 0);
+	}
+	//the portals exist before the producer starts sending
+	Consumer.RefreshDirectory();
+	TestEqual(TEXT("A reader per claimed slot"), Consumer.Readers.Num(), int32(StandInPins));
+
+	//the producer may run half a ring ahead of the frame being rendered, like MediaZ does with its pipeline depth
+	std::atomic<uint32> RenderedFrame = 0;
+	std::atomic<uint32> FailedWrites = 0;
+	std::thread ProducerThread([&]()
+		{
+			for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+			{
+				while (Frame > RenderedFrame.load(std::memory_order_acquire) + MZSharedPins::RingSize / 2)
+				{
+					std::this_thread::yield();
+				}
+				for (uint32 Pin = 0; Pin < StandInPins; ++Pin)
+				{
+					FailedWrites += !Producer.Write(Slots[Pin], Tokens[Pin], Pin, Frame);
+				}
+			}
+		});
+
+	//FMZPropertyManager::OnBeginFrame: pins 0 and 1 are track inputs that need the sample of the frame, 2 and 3 take the newest value
+	TArray<uint8> Value;
+	uint32 Missing = 0;
+	uint32 Wrong = 0;
+	uint32 Backwards = 0;
+	uint32 LatestReads = 0;
+	uint32 LastFrame[StandInPins] = {};
+	for (uint32 Frame = 1; Frame <= Frames; ++Frame)
+	{
+		for (uint32 Pin = 0; Pin < StandInPins; ++Pin)
+		{
+			bool bFrameOrdered = Pin < 2;
+			uint32 ReadFrame = 0;
+			bool bRead = Consumer.Read(GetStandInPinId(Pin), Frame, bFrameOrdered, Value, ReadFrame);
+			double Deadline = FPlatformTime::Seconds() + 5.0;
+			while (bFrameOrdered && !bRead && FPlatformTime::Seconds() < Deadline)
+			{
+				std::this_thread::yield();
+				bRead = Consumer.Read(GetStandInPinId(Pin), Frame, bFrameOrdered, Value, ReadFrame);
+			}
+			if (!bRead)
+			{
+				Missing += bFrameOrdered;
+				continue;
+			}
+			LatestReads += !bFrameOrdered;
+			Wrong += !IsStandInValue(Value, Pin, ReadFrame) || (bFrameOrdered && ReadFrame != Frame);
+			Backwards += ReadFrame <= LastFrame[Pin];
+			LastFrame[Pin] = ReadFrame;
+		}
+		RenderedFrame.store(Frame, std::memory_order_release);
+	}
+	ProducerThread.join();
+
+	TestEqual(TEXT("Failed writes"), FailedWrites.load(), 0u);
+	TestEqual(TEXT("Frames missing on track pins"), Missing, 0u);
+	TestEqual(TEXT("Wrong or torn values"), Wrong, 0u);
+	TestEqual(TEXT("Values older than an earlier read"), Backwards, 0u);
+	TestTrue(TEXT("Property pins received values"), LatestReads > 0);
+
+	//the producer stops sending pin 3: its reader goes away
+	uint32 ReadFrame = 0;
+	TestTrue(TEXT("Producer releases its slot"), MZSharedPins::ReleaseSlot(*Producer.Seg, Slots[3], Tokens[3]));
+	TestFalse(TEXT("Released pin is not read"), Consumer.Read(GetStandInPinId(3), Frames, false, Value, ReadFrame));
+	TestFalse(TEXT("Reader of the released pin is pruned"), Consumer.Readers.Contains(GetStandInPinId(3)));
+
+	//pin 2 is unregistered: its slot is reclaimed and the producer has to claim it again
+	Consumer.ReleasePin(GetStandInPinId(2));
+	TestFalse(TEXT("Reader of the unregistered pin is pruned"), Consumer.Readers.Contains(GetStandInPinId(2)));
+	TestFalse(TEXT("Reclaimed slot rejects the producer"), Producer.Write(Slots[2], Tokens[2], 2, Frames + 1));
+	uint32_t Token = 0;
+	int32_t Reclaimed = Producer.Claim(GetStandInPinId(2), Token);
+	TestTrue(TEXT("Pin claims a slot again"), Reclaimed >= 0 && Token != Tokens[2]);
+	TestTrue(TEXT("Pin writes to its new claim"), Reclaimed >= 0 && Producer.Write(Reclaimed, Token, 2, Frames + 1));
+	TestTrue(TEXT("Value of the new claim is read"), Consumer.Read(GetStandInPinId(2), Frames + 1, false, Value, ReadFrame) && IsStandInValue(Value, 2, Frames + 1));
+
+	//a new pin in the slot pin 3 left must not see its samples
+	FGuid NewPin = GetStandInPinId(StandInPins);
+	int32_t NewSlot = Producer.Claim(NewPin, Token);
+	TestTrue(TEXT("New pin claims a released slot"), NewSlot >= 0);
+	TestFalse(TEXT("New pin has no value before it is written"), Consumer.Read(NewPin, Frames + 1, false, Value, ReadFrame));
+	TestTrue(TEXT("New pin is read once written"), NewSlot >= 0 && Producer.Write(NewSlot, Token, StandInPins, Frames + 1)
+		&& Consumer.Read(NewPin, Frames + 1, false, Value, ReadFrame) && IsStandInValue(Value, StandInPins, Frames + 1));
+	TestEqual(TEXT("Readers of the claimed slots"), Consumer.Readers.Num(), int32(StandInPins));
+
+	Consumer.Release();
+	return true;
+}
+
+#endif
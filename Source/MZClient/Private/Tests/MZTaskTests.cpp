@@ -0,0 +1,136 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZTask.h"
+#include "MZPinPayload.h"
+#include "MZAllocationCounter.h"
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Run them with "Automation RunTests MediaZ.Client.TaskRing", ideally on a build with many cores.
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZTaskRingTest, "MediaZ.Client.TaskRing.Mpsc", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZTaskRingTest::RunTest(const FString& Parameters)
+{
+	struct FItem
+	{
+		uint32 Producer = 0;
+		uint32 Index = 0;
+	};
+
+	constexpr uint32 Producers = 4;
+	constexpr uint32 ItemsPerProducer = 200000;
+
+	//small ring so the overflow path is exercised as well
+	TMZMpscRing<FItem> Ring(64);
+	std::vector<std::thread> Threads;
+	for (uint32 P = 0; P < Producers; ++P)
+	{
+		Threads.emplace_back([&Ring, P]()
+			{
+				for (uint32 i = 1; i <= ItemsPerProducer; ++i)
+				{
+					Ring.Enqueue({ P, i });
+				}
+			});
+	}
+
+	//items of one producer have to come out in the order it queued them
+	uint32 Last[Producers] = {};
+	uint32 OutOfOrder = 0;
+	for (uint32 Received = 0; Received < Producers * ItemsPerProducer;)
+	{
+		FItem* Item = Ring.Peek();
+		if (!Item)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		OutOfOrder += Item->Index != Last[Item->Producer] + 1;
+		Last[Item->Producer] = Item->Index;
+		Ring.Pop();
+		Received++;
+	}
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	TestEqual(TEXT("Items out of order"), OutOfOrder, 0u);
+	TestNull(TEXT("Ring is empty"), Ring.Peek());
+	AddInfo(FString::Printf(TEXT("%llu items went through the overflow queue"), Ring.Overflows.load()));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZTaskAllocationTest, "MediaZ.Client.TaskRing.Allocations", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZTaskAllocationTest::RunTest(const FString& Parameters)
+{
+	constexpr uint32 WarmUpEvents = 1000;
+	constexpr uint32 Events = 10000;
+
+	//what the gRPC thread does for a frame ordered pin value: copy it, queue the broadcast, and the game thread runs it
+	uint8_t Value[128] = {};
+	uint32 Invoked = 0;
+	auto MakeBroadcast = [&Invoked, &Value]()
+		{
+			MZPinPayload Payload(Value, sizeof(Value));
+			FGuid Id(1, 2, 3, 4);
+			bool bReset = false;
+			return [Counter = &Invoked, Payload = MoveTemp(Payload), Id, bReset]()
+				{
+					*Counter += Payload.Size() != 0 && Id.IsValid() && !bReset;
+				};
+		};
+
+	auto CountAllocationsPerEvent = [&](TFunctionRef<void()> Event)
+		{
+			for (uint32 i = 0; i < WarmUpEvents; ++i)
+			{
+				Event();
+			}
+			FMZScopedAllocationCounter Counter;
+			for (uint32 i = 0; i < Events; ++i)
+			{
+				Event();
+			}
+			return double(Counter.GetCount()) / Events;
+		};
+
+	//the queue the plugin used before FMZTask
+	TQueue<std::function<void()>, EQueueMode::Mpsc> LegacyQueue;
+	double LegacyAllocations = CountAllocationsPerEvent([&]()
+		{
+			LegacyQueue.Enqueue(MakeBroadcast());
+			std::function<void()> Task;
+			while (LegacyQueue.Dequeue(Task))
+			{
+				Task();
+			}
+		});
+
+	static_assert(FMZTask::FitsInline<decltype(MakeBroadcast())>, "The pin value broadcast should be stored inline");
+	TMZMpscRing<FMZTask> Ring(4096);
+	double TaskAllocations = CountAllocationsPerEvent([&]()
+		{
+			Ring.Enqueue(MakeBroadcast());
+			while (FMZTask* Task = Ring.Peek())
+			{
+				(*Task)();
+				Ring.Pop();
+			}
+		});
+
+	AddInfo(FString::Printf(TEXT("Allocations per pin value event: %.2f with std::function in TQueue, %.2f with FMZTask in TMZMpscRing"), LegacyAllocations, TaskAllocations));
+	TestEqual(TEXT("Every task ran"), Invoked, 2 * (WarmUpEvents + Events));
+	TestEqual(TEXT("Allocations per pin value event"), TaskAllocations, 0.0);
+	return true;
+}
+
+#endif
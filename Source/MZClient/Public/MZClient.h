@@ -19,83 +19,37 @@
 #include "AppEvents_generated.h"
 #include <mzFlatBuffersCommon.h>
 #include <functional> 
+#include <deque>
 
-struct PinDataQueue : public TQueue<TPair<mz::Buffer, uint32_t>>
-{
-	bool LiveNow = true;
+#include "MZPinDataQueue.h"
+#include "MZTask.h"
+#include "MZConsoleForwarder.h"
+#include "MZConsoleAutoComplete.h"
+#include "MZConnectionManager.h"
+#include "MZSessionRecorder.h"
+#include "MZSharedPinMemory.h"
+#include "MZNodeUpdateCoalescer.h"
+#include "MZFlatBufferBuilder.h"
+#include "MZOutboundDedup.h"
+#include "MZFrameClock.h"
 
-	void DiscardExcessThenDequeue(TPair<mz::Buffer, uint32_t>& result, uint32_t requestedFrameNumber, bool wait)
-	{
-		u32 tryCount = 0;
-		bool dequeued = false;
-		bool oldLiveNow = LiveNow;
-		FPlatformProcess::ConditionalSleep([&]()
-			{
-				while (Dequeue(result))
-				{
-					LiveNow = true;
-					dequeued = true;
-					if (result.Value >= requestedFrameNumber)
-						return true;
-				}
-
-				return !LiveNow || !wait || tryCount++ > 20;
-			}, 0.001f);
-		
-		LiveNow = dequeued;
-		if (oldLiveNow != LiveNow)
-			UE_LOG(LogCore, Warning, TEXT("LiveNow Changed"));
 
-		if (LiveNow && result.Value != requestedFrameNumber)
-			UE_LOG(LogCore, Warning, TEXT("Mismatch between popped frame number and requested frame number: %i, %i"), result.Value, requestedFrameNumber);
-	}
-};
+class UMZCustomTimeStep;
+typedef std::function<void()> Task;
 
-class PinDataQueues : public mz::app::IEventDelegates
+//Kind of a task queued from the grpc threads, used for the queue stats and the tick budget.
+//Pin values, function calls and tree updates run in the order they were queued, except that pin values keep running
+//once the budget is spent while function calls wait, a pin value never overtakes a tree update.
+//Console and diagnostic tasks have their own queue and only get the budget left after the others.
+enum class EMZTaskClass : uint8
 {
-public:
-	virtual ~PinDataQueues() {}
-
-	PinDataQueue* GetAddQueue(mz::fb::UUID const& pinId)
-	{
-		uuids::uuid id(pinId.bytes()->begin(), pinId.bytes()->end());
-
-		std::scoped_lock<std::mutex> lock(Guard);
-		return &Queues[id];
-	}
-
-	virtual void OnPinValueChanged(mz::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset, uint32_t frameNumber) override
-	{
-		if (reset)
-		{
-			std::scoped_lock<std::mutex> lock(Guard);
-			for (auto& [_, queue] : Queues)
-				queue.Empty();
-
-			return;
-		}
-
-		auto queue = GetAddQueue(pinId);
-		queue->Enqueue({ mz::Buffer(data, size), frameNumber });
-	}
-
-	mz::Buffer Pop(mz::fb::UUID const& pinId, bool wait, uint32_t frameNumber)
-	{
-		auto queue = GetAddQueue(pinId);
-
-		TPair<mz::Buffer, uint32_t> result;
-		queue->DiscardExcessThenDequeue(result, frameNumber, wait);
-		return result.Key;
-	}
-
-	std::mutex Guard;
-	std::unordered_map<uuids::uuid, PinDataQueue> Queues;
+	PinValue,
+	FunctionCall,
+	TreeUpdate,
+	Console,
+	Count
 };
 
-
-class UMZCustomTimeStep;
-typedef std::function<void()> Task;
-
 DECLARE_LOG_CATEGORY_EXTERN(LogMZClient, Log, All);
 
 //events coming from mediaz
@@ -141,7 +95,24 @@ public:
 	virtual void OnLoadNodesOnPaths(mz::LoadNodesOnPaths const* loadNodesOnPathsRequest) override;
 	virtual void OnCloseApp() override;
 
+	//Game thread, takes the value waiting in the mailbox of the pin
+	MZPinPayload TakeLatestPinValue(FGuid const& pinId);
+
 	FMZClient* PluginClient;
+
+	// Property pin values that were overwritten before the game thread applied them
+	std::atomic<uint64_t> CoalescedPinValues = 0;
+
+private:
+	struct PinMailbox
+	{
+		MZPinPayload Latest;
+		bool Scheduled = false;
+	};
+
+	//Newer values of a property pin replace older unconsumed ones, only one task per pin waits in the task queue
+	std::mutex MailboxGuard;
+	TMap<FGuid, PinMailbox> Mailboxes;
 };
 
 
@@ -149,25 +120,46 @@ class UENodeStatusHandler
 {
 public:
 	void SetClient(FMZClient* PluginClient);
+	//Only marks the status dirty if the message differs from the current one
 	void Add(std::string const& Id, mz::fb::TNodeStatusMessage const& Status);
 	void Remove(std::string const& Id);
+	//Sends the statuses again with the next update, e.g. after MediaZ reconnected
+	void Invalidate() { Dirty = true; }
+	//Sends the statuses if they changed, at most mediaz.NodeStatus.MaxUpdatesPerSecond times a second
 	void Update();
 private:
 	void SendStatus();
 	FMZClient* PluginClient = nullptr;
 	std::unordered_map<std::string, mz::fb::TNodeStatusMessage> StatusMessages;
 	bool Dirty = false;
+	double LastSendTime = 0;
 };
 
-class FPSCounter
+// Frame time distribution over the last WindowSize frames, percentiles and the maximum are exact over the window.
+// Recorded on the game thread, samples are atomics so the summary can be read from any thread.
+class FMZFrameTimeHistogram
 {
 public:
-	bool Update(float dt);
+	static constexpr uint32 WindowSize = 512;
+
+	//In milliseconds
+	struct FSummary
+	{
+		float P50 = 0;
+		float P95 = 0;
+		float P99 = 0;
+		float Max = 0;
+	};
+
+	void Record(float DeltaSeconds);
+
+	FSummary GetSummary() const;
+
 	mz::fb::TNodeStatusMessage GetNodeStatusMessage() const;
 private:
-	float DeltaTimeAccum = 0;
-	uint64_t FrameCount = 0;
-	float FramesPerSecond = 0;
+	std::atomic<float> Window[WindowSize] = {};
+	std::atomic<uint32> Count = 0;
+	uint32 WindowPos = 0;
 };
 
 class MZCLIENT_API FMediaZ
@@ -206,7 +198,7 @@ public:
 	/// @return Connection status with MediaZ Engine
 	virtual bool IsConnected();
 
-	//Tries to initialize connection with the MediaZ engine
+	//Starts the connection thread once the world is initialized and picks up its state changes, only reads an atomic per tick
 	void TryConnect();
 
 	//Tick is called every frame once and handles the tasks queued from grpc threads
@@ -231,16 +223,42 @@ public:
 	TSharedPtr<MZEventDelegates> EventDelegates = 0;
 
 	//To send events to mediaz and communication
-	mz::app::IAppServiceClient* AppServiceClient = nullptr;
+	IMZTransport* AppServiceClient = nullptr;
 
-	//Task queue
-	TQueue<Task, EQueueMode::Mpsc> TaskQueue;
+	//Connects to MediaZ from its own thread and reconnects with backoff
+	TUniquePtr<MZConnectionManager> ConnectionManager;
+
+	//Queues a task to be run on the game thread, can be called from any thread
+	void EnqueueTask(EMZTaskClass Class, FMZTask&& task);
+
+	struct FQueuedTask
+	{
+		FMZTask Task;
+		EMZTaskClass Class = EMZTaskClass::PinValue;
+	};
+
+	//One queue for the pin, function and tree tasks so a pin value never overtakes the tree update that creates its pin
+	TMZMpscRing<FQueuedTask> TaskQueue{ 4096 };
+	//Console and diagnostic tasks
+	TMZMpscRing<FQueuedTask> LowPriorityTaskQueue{ 256 };
+	//Function calls and tree updates taken from TaskQueue after the budget ran out, run first next frame. Game thread only.
+	//A deque since inline tasks point into themselves and cannot be relocated the way TArray does.
+	std::deque<FQueuedTask> DeferredTasks;
+	std::atomic<int32> TaskQueueDepths[(int)EMZTaskClass::Count] = {};
+	//Number of tasks left for the next frame because the tick budget ran out
+	int32 CarriedOverTasks = 0;
 
 	//Custom time step implementation for mediaZ controlling the unreal editor in play mode
 	UPROPERTY()
 	TWeakObjectPtr<UMZCustomTimeStep> MZTimeStep = nullptr;
 	bool CustomTimeStepBound = false;
 
+	//Frame index, time and timecode of the frames stepped by MediaZ, null until the custom time step is bound
+	FMZFrameClock const* GetFrameClock() const;
+
+	//Any thread, events from MediaZ are dropped while a session replay feeds the event delegates, so it stays the only producer
+	bool IsLiveEventBlocked() const;
+
 	// MediaZ root node id
 	static FGuid NodeId;
 	// The app key we are using for MediaZ
@@ -265,12 +283,33 @@ public:
 	
 	UENodeStatusHandler UENodeStatusHandler;
 
+	//Batches console output and sends it to MediaZ from its own thread
+	TUniquePtr<MZConsoleForwarder> ConsoleForwarder;
+
+	//Answers autocomplete requests from MediaZ, rebuilt when modules are loaded or unloaded
+	MZConsoleAutoComplete ConsoleAutoComplete;
+
+	//Record and replay of the events received from MediaZ, see mediaz.Record.Start and mediaz.Replay
+	MZSessionRecorder SessionRecorder;
+	TUniquePtr<MZSessionReplayer> SessionReplayer;
+
+	//Segment producers can write high rate pin values to instead of sending them over gRPC
+	MZSharedPinMemory SharedPins;
+
+	//Partial node updates of the scene tree go through here and are sent once per node at the end of the frame
+	FMZNodeUpdateCoalescer NodeUpdates = FMZNodeUpdateCoalescer(this);
+
+	//Skips resending node states, pin values and lists MediaZ already has
+	FMZOutboundDedup OutboundDedup;
+
 	int ReloadingLevel = 0;
 	
 protected:
 	void Reset();
+	void DrainTaskQueues();
 
-	FPSCounter FPSCounter;
+	FMZFrameTimeHistogram FrameTimes;
+	double LastFrameTimeStatus = 0;
 	bool IsWorldInitialized = false;
 
 };
@@ -278,25 +317,25 @@ protected:
 class MZConsoleOutput : public FOutputDevice
 {
 public:
-	FMZClient* MZClient;
+	MZConsoleForwarder* Forwarder;
 	MZConsoleOutput(FMZClient* MZClient)
-		: FOutputDevice(), MZClient(MZClient)
+		: MZConsoleOutput(MZClient ? MZClient->ConsoleForwarder.Get() : nullptr)
+	{
+	}
+	explicit MZConsoleOutput(MZConsoleForwarder* Forwarder)
+		: FOutputDevice(), Forwarder(Forwarder)
 	{
 	}
 
 	virtual void Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const class FName& Category) override
 	{
-		if (!MZClient || FString(V).IsEmpty())
+		if (!Forwarder || !V || !*V)
 		{
 			return;
 		}
 		
-		flatbuffers::FlatBufferBuilder mb;
-		auto offset = mz::CreateAppEventOffset(mb ,mz::app::CreateConsoleOutputDirect(mb, TCHAR_TO_UTF8(V)));
-		mb.Finish(offset);
-		auto buf = mb.Release();
-		auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
-		MZClient->AppServiceClient->Send(*root);
+		//sent in batches from the forwarder thread
+		Forwarder->Append(V, Category);
 	}
 };
 
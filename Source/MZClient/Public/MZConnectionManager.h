@@ -0,0 +1,78 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Math/RandomStream.h"
+#include <atomic>
+
+#include "MZTransport.h"
+
+enum class EMZConnectionState : uint8
+{
+	Disconnected,
+	Connecting,
+	Connected,
+	Backoff,
+};
+
+// Keeps the plugin connected to MediaZ from its own thread so connection attempts never run on the game thread.
+// Endpoints are tried in turn, failed attempts are retried after an exponentially growing, jittered delay.
+// The game thread only reads the published state and the client of the endpoint that is connected.
+class MZCLIENT_API MZConnectionManager : public FRunnable
+{
+public:
+	MZConnectionManager();
+	virtual ~MZConnectionManager();
+
+	//Game thread, creates one transport per endpoint, or a loopback transport with -mzloopback, and starts connecting
+	void Start(mz::app::IEventDelegates* EventDelegates, FString const& AppKey);
+	//Game thread, starts connecting through the given transports, one per endpoint name
+	void Start(TArray<TUniquePtr<IMZTransport>>&& Transports, TArray<FString> const& Names);
+	void Shutdown();
+
+	EMZConnectionState GetState() const { return State.load(std::memory_order_acquire); }
+
+	//Transport of the endpoint that was connected last, stays valid until Shutdown
+	IMZTransport* GetActiveClient() const { return ActiveClient.load(std::memory_order_acquire); }
+
+	//Any thread, wakes the connection thread so a closed connection is retried without waiting for the next poll
+	void NotifyConnectionClosed();
+
+	bool IsStarted() const { return Thread != nullptr; }
+
+	//Any thread, no new connection is attempted while suspended, an established one is kept
+	void SetSuspended(bool bSuspended);
+
+	//Endpoints given with -mzendpoints=host:port,host:port or localhost:50053
+	static TArray<FString> GetEndpoints();
+
+	//Delay before the next attempt after FailedAttempts failures in a row, between half and all of the exponential delay
+	static int64 GetBackoffDelayMs(uint32 FailedAttempts, int32 EndpointCount, FRandomStream& Jitter);
+
+	//Connection attempts made so far, any thread
+	std::atomic<uint32> ConnectAttempts = 0;
+
+	virtual void Stop() override;
+
+private:
+	virtual uint32 Run() override;
+
+	//Returns true if the connection was established and has been lost since
+	bool ConnectAndWait(uint32 EndpointIndex);
+	void WaitBackoff(uint32 FailedAttempts);
+
+	TArray<FString> Endpoints;
+	TArray<TUniquePtr<IMZTransport>> Clients;
+	FRandomStream JitterStream;
+
+	std::atomic<EMZConnectionState> State = EMZConnectionState::Disconnected;
+	std::atomic<IMZTransport*> ActiveClient = nullptr;
+	std::atomic<bool> bExit = false;
+	std::atomic<bool> bSuspended = false;
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,44 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+// Prefix index over the names of all registered console objects, used to answer autocomplete requests from MediaZ.
+// Names are kept sorted and every trie node stores the range of names starting with its prefix,
+// so a lookup only walks the characters of the input. Game thread only, except MarkDirty.
+class MZCLIENT_API MZConsoleAutoComplete
+{
+public:
+	void Initialize();
+	void Shutdown();
+
+	//Fills Out with at most mediaz.AutoComplete.PageSize names starting with Input, beginning at the First-th match.
+	//Returns the total number of matches.
+	int32 GetSuggestions(const FString& Input, TArray<FString>& Out, int32 First = 0);
+
+	void MarkDirty() { bDirty = true; }
+
+private:
+	struct FNode
+	{
+		int32 Begin = 0;
+		int32 End = 0;
+		TArray<TPair<TCHAR, int32>> Children;
+	};
+
+	void Rebuild();
+	int32 FindChild(int32 NodeIndex, TCHAR Char) const;
+	int32 FindNode(const FString& Input) const;
+
+	TArray<FString> Names;
+	TArray<FNode> Nodes;
+	std::atomic<bool> bDirty = true;
+	double LastRebuildTime = 0;
+	FDelegateHandle ModulesChangedHandle;
+	FDelegateHandle ConsoleObjectRegisteredHandle;
+	FDelegateHandle ConsoleObjectUnregisteredHandle;
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+class FMZClient;
+
+// Forwards console output to MediaZ without sending from the logging thread.
+// Serialize calls only append to a bounded lock-free ring, a background thread joins the lines
+// and sends them as one ConsoleOutput event every mediaz.ConsoleForward.FlushIntervalMs.
+class MZCLIENT_API MZConsoleForwarder : public FRunnable
+{
+public:
+	MZConsoleForwarder(FMZClient* MZClient);
+	virtual ~MZConsoleForwarder();
+
+	void Start();
+	void Shutdown();
+
+	//Any thread, returns false if the line is dropped by the rate limit or because the ring is full
+	bool Append(const TCHAR* Line, const FName& Category);
+
+	virtual void Stop() override;
+
+	// Lines dropped since the last flush, reported to MediaZ with the next batch
+	std::atomic<uint64> DroppedLines = 0;
+
+private:
+	friend class FMZConsoleForwarderRingTest;
+
+	virtual uint32 Run() override;
+
+	bool TryPush(const char* Text, uint32 Length);
+	bool TryPop(std::string& Out);
+	bool PassesRateLimit(const FName& Category);
+	void Flush();
+
+	static constexpr uint32 Capacity = 1024;
+	static constexpr uint32 MaxLineLength = 500;
+	static constexpr uint32 RateBucketCount = 64;
+
+	struct FSlot
+	{
+		std::atomic<uint64> Sequence;
+		uint32 Length;
+		char Text[MaxLineLength];
+	};
+
+	struct FRateBucket
+	{
+		std::atomic<uint32> Second = 0;
+		std::atomic<uint32> Count = 0;
+	};
+
+	FMZClient* MZClient;
+	std::unique_ptr<FSlot[]> Slots;
+	FRateBucket RateBuckets[RateBucketCount];
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> EnqueuePos = 0;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> DequeuePos = 0;
+
+	std::string Batch;
+	std::atomic<bool> bExit = false;
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+};
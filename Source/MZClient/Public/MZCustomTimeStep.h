@@ -35,51 +35,21 @@ public:
 
 	}
 
-	void Step(mz::fb::vec2u deltaSeconds)
-	{
-		std::unique_lock lock(Mutex);
-		if(deltaSeconds.x() != 0)
-		{
-			CustomDeltaTime = deltaSeconds.x() / (double)deltaSeconds.y();
-		}
-		IsReadyForNextStep = true;
-		lock.unlock();
-		CV.notify_one();
-	}
+	//Called from the grpc thread when MediaZ executed the node, releases the frame waiting in UpdateTimeStep
+	void Step(mz::fb::vec2u deltaSeconds);
 
 	/**
-	 * Update FApp::CurrentTime/FApp::DeltaTime and optionally wait until the end of the frame.
+	 * Update FApp::CurrentTime/FApp::DeltaTime and, in frame lock mode, wait until MediaZ signals the next step.
 	 * @return	true if the Engine's TimeStep should also be performed; false otherwise.
 	 */
-	bool UpdateTimeStep(class UEngine* InEngine) override
-	{
-		// UpdateApplicationLastTime();
-		if (FMath::IsNearlyZero(FApp::GetLastTime()))
-		{
-			FApp::SetCurrentTime(FPlatformTime::Seconds() - 0.0001);
-		}
-		FApp::SetCurrentTime(FApp::GetLastTime() + CustomDeltaTime);
-		FApp::UpdateLastTime();
-		FApp::SetDeltaTime(CustomDeltaTime);	
-		if (PluginClient && PluginClient->IsConnected() /*&& IsGameRunning()*/)
-		{
-			// std::unique_lock lock(Mutex);
-			// CV.wait(lock, [this] { return IsReadyForNextStep; });
-			IsReadyForNextStep = false;
-			return false;
-		}
-		else
-		{
-			return true;
-		}
-	}
+	bool UpdateTimeStep(class UEngine* InEngine) override;
 
 	/** The state of the CustomTimeStep. */
 	ECustomTimeStepSynchronizationState GetSynchronizationState() const override
 	{
 		if (PluginClient && PluginClient->IsConnected())
 		{
-			return ECustomTimeStepSynchronizationState::Synchronized;
+			return FrameLocked ? ECustomTimeStepSynchronizationState::Synchronized : ECustomTimeStepSynchronizationState::Synchronizing;
 		}
 		else
 		{
@@ -87,8 +57,12 @@ public:
 		}
 	}
 
-	class FMZClient* PluginClient = nullptr;
+	void DumpStats(FOutputDevice& Ar) const;
+
+	//Game thread, frames locked to MediaZ so far
+	FMZFrameClock const& GetFrameClock() const { return Clock; }
 
+	class FMZClient* PluginClient = nullptr;
 
 private:
 	bool IsGameRunning()
@@ -97,9 +71,38 @@ private:
 			return (GEditor && GEditor->IsPlaySessionInProgress());
 	}
 
+	//Spins for mediaz.FrameLock.SpinUs, then blocks and spins again close to the deadline.
+	//Returns false if the step signal did not arrive before Deadline.
+	bool WaitForStep(double Deadline);
+	void RecordFrame(double WaitStart, double WaitEnd, bool TimedOut);
+
 	std::mutex Mutex;
 	std::condition_variable CV;
-	bool IsReadyForNextStep = false;
-	double CustomDeltaTime = 1. / 50.;
+	//Step signals not consumed by the game thread yet, more than one if MediaZ stepped again before the frame started
+	std::atomic<uint32> PendingSteps = 0;
+	//Guarded by Mutex, Step only notifies if the game thread is blocked
+	bool IsWaiting = false;
+	std::atomic<double> SignalTime = 0;
+	//Guarded by Mutex, last frame duration received from MediaZ
+	uint32 StepNumerator = 1;
+	uint32 StepDenominator = 50;
+
+	//Cleared when a step did not arrive in time, the engine free runs until the next step signal
+	bool FrameLocked = true;
+
+	//Game thread only
+	FMZFrameClock Clock;
+	FMZFrameTimeHistogram WaitTimes;
+	FMZFrameTimeHistogram Overshoots;
+	double LastWaitMs = 0;
+	double LastOvershootMs = 0;
+	//Engine time minus wall clock time since the lock was last established, positive when the engine runs ahead
+	double DriftMs = 0;
+	double LockStartSeconds = 0;
+	double LockStartAppTime = 0;
+	uint64 LockedFrames = 0;
+	uint64 Timeouts = 0;
+	//Steps beyond the first that were consumed by one engine frame
+	uint64 CaughtUpSteps = 0;
 };
 
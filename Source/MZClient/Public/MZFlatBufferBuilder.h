@@ -0,0 +1,40 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+#pragma warning (disable : 4800)
+#pragma warning (disable : 4668)
+
+#include "MediaZ/AppAPI.h"
+
+// Flatbuffer allocator that keeps freed buffers in a small per thread cache instead of returning them to the heap.
+// Buffers keep the size they grew to, so a thread that keeps building similar messages stops allocating once
+// its cache holds buffers of their high water mark. Buffers released from a builder may be freed on any thread,
+// they are then cached by that thread.
+class MZCLIENT_API FMZFlatBufferAllocator : public flatbuffers::Allocator
+{
+public:
+	static FMZFlatBufferAllocator& Get();
+
+	virtual uint8_t* allocate(size_t size) override;
+	virtual void deallocate(uint8_t* p, size_t size) override;
+
+	// Allocations served from a thread cache and from the heap
+	std::atomic<uint64> PooledAllocations = 0;
+	std::atomic<uint64> HeapAllocations = 0;
+};
+
+// Builder for all outbound messages, backed by the pooled allocator
+class FMZFlatBufferBuilder : public flatbuffers::FlatBufferBuilder
+{
+public:
+	explicit FMZFlatBufferBuilder(size_t InitialSize = 1024)
+		: flatbuffers::FlatBufferBuilder(InitialSize, &FMZFlatBufferAllocator::Get(), false)
+	{
+	}
+};
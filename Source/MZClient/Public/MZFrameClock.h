@@ -0,0 +1,37 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/FrameRate.h"
+#include "Misc/Timecode.h"
+
+// Engine time of the frames stepped by MediaZ, kept as a frame count at the rational frame duration MediaZ sends.
+// Time is derived from the count instead of being accumulated so 59.94 or 29.97 does not drift over a long show.
+// Only a change of the frame rate or a new time origin rounds, once.
+class MZCLIENT_API FMZFrameClock
+{
+public:
+	//Later frames are counted from Seconds, the frame index keeps increasing
+	void Rebase(double Seconds);
+	//Duration of a frame is Numerator / Denominator seconds, rebases if it changed
+	void SetFrameDuration(uint32 Numerator, uint32 Denominator);
+	void Advance(uint32 Frames = 1) { FrameIndex += Frames; }
+
+	uint64 GetFrameIndex() const { return FrameIndex; }
+	double GetSeconds() const;
+	double GetFrameDuration() const { return Numerator / (double)Denominator; }
+	FFrameRate GetFrameRate() const { return FFrameRate(Denominator, Numerator); }
+	//Frame index as a timecode at the current frame rate, drop frame where the rate supports it.
+	//Counts from the start of the plugin, not from midnight, and wraps after 24 hours.
+	FTimecode GetTimecode() const;
+
+private:
+	uint64 FrameIndex = 0;
+	uint64 SegmentStartFrame = 0;
+	double SegmentStartSeconds = 0;
+	uint32 Numerator = 1;
+	uint32 Denominator = 50;
+};
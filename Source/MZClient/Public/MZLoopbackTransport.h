@@ -0,0 +1,80 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "MZTransport.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+enum class EMZLoopbackMessage : uint8
+{
+	AppEvent,
+	PartialNodeUpdate,
+	PinShowAsChange,
+	ContextMenuUpdate,
+	PinValueChanged,
+	StringList,
+};
+
+// In-process stand-in for MediaZ, used with -mzloopback.
+// Outbound messages are copied into standalone buffers a driver can inspect,
+// inbound events are injected by the driver and reach the event delegates the same way the SDK would deliver them.
+class MZCLIENT_API FMZLoopbackTransport : public IMZTransport
+{
+public:
+	struct FMessage
+	{
+		EMZLoopbackMessage Type;
+		double Time;
+		//Finished flatbuffer of the message table, empty for show as changes
+		flatbuffers::DetachedBuffer Buffer;
+		mz::fb::UUID PinId;
+		mz::fb::ShowAs ShowAs;
+	};
+
+	static bool IsRequested();
+
+	virtual void RegisterEventDelegates(mz::app::IEventDelegates* EventDelegates) override;
+	//Connects immediately and reports the app as connected with no node
+	virtual void TryConnect() override;
+	virtual bool IsConnected() override { return bConnected; }
+
+	virtual void Send(mz::app::AppEvent const& Event) override;
+	virtual void SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update) override;
+	virtual void SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs) override;
+	virtual void SendContextMenuUpdate(mz::ContextMenuUpdate const& Update) override;
+	virtual void NotifyPinValueChanged(mz::PinValueChanged const& Value) override;
+	virtual void UpdateStringList(mz::app::UpdateStringList const& List) override;
+
+	//Any thread, returns the outbound messages recorded since the last call
+	std::vector<FMessage> TakeOutbound();
+	void SetRecordOutbound(bool bRecord) { bRecordOutbound = bRecord; }
+
+	//Any thread, calls the event delegates as if the event came from MediaZ. Ignored while disconnected.
+	void Dispatch(TFunctionRef<void(mz::app::IEventDelegates&)> Event);
+	void InjectNodeUpdated(mz::fb::Node const& Node);
+	void InjectPinValue(mz::fb::UUID const& PinId, uint8_t const* Data, size_t Size, uint32_t FrameNumber, bool bReset = false);
+
+	//Drops the connection like a closed channel would, the connection thread connects again after its backoff
+	void Disconnect();
+
+	// Every message sent, whether it is recorded or not
+	std::atomic<uint64_t> OutboundCount = 0;
+	// Only recorded messages, sizing a message means packing it into its own buffer which is skipped when recording is off
+	std::atomic<uint64_t> RecordedCount = 0;
+	std::atomic<uint64_t> RecordedBytes = 0;
+
+private:
+	template <typename T>
+	void Record(EMZLoopbackMessage Type, T const& Table);
+	void Record(FMessage&& Message);
+
+	mz::app::IEventDelegates* EventDelegates = nullptr;
+	std::atomic<bool> bConnected = false;
+	std::atomic<bool> bRecordOutbound = true;
+	std::mutex OutboundGuard;
+	std::vector<FMessage> Outbound;
+};
@@ -0,0 +1,60 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <memory>
+#include <vector>
+
+#pragma warning (disable : 4800)
+#pragma warning (disable : 4668)
+
+#include "MediaZ/AppAPI.h"
+
+class FMZClient;
+
+// Collects the partial node updates of a frame and sends one merged message per node when flushed.
+// Nodes are sent in the order they were first touched. An update that removes or clears anything is only merged
+// into the most recently touched node, and re-adding something removed earlier in the frame is never merged,
+// in both cases everything pending is sent first so MediaZ sees the operations in the original order.
+// Full node states sent with a hash are only recorded in FMZOutboundDedup once they are actually sent, any other update
+// forgets the recorded state of its node and of the node's ancestors, since those include the node when serialized.
+// Game thread only.
+class MZCLIENT_API FMZNodeUpdateCoalescer
+{
+public:
+	FMZNodeUpdateCoalescer(FMZClient* MZClient);
+
+	//Same signature as the transport so call sites only change the receiver.
+	//StateHash is set for full node states checked with FMZOutboundDedup::ShouldSendDeferred.
+	void SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update, TOptional<uint64> StateHash = {});
+
+	//Sends the pending updates, called at the end of the frame and before messages that refer to the nodes or pins
+	void Flush();
+	bool HasPending() const { return !Pending.empty(); }
+
+	//Updates received and messages actually sent, for comparing the two
+	uint64 SubmittedCount = 0;
+	uint64 SentCount = 0;
+
+	//Returns the parent of a node or an invalid id, set by the module that owns the scene tree
+	TFunction<FGuid(FGuid const&)> GetParentId;
+
+private:
+	struct FPendingUpdate
+	{
+		std::unique_ptr<mz::TPartialNodeUpdate> Update;
+		//Hash of the full node state if that is what the update sets last
+		TOptional<uint64> StateHash;
+	};
+
+	bool CanMerge(int32 PendingIndex, mz::TPartialNodeUpdate const& Update) const;
+	static void Merge(mz::TPartialNodeUpdate& Pending, mz::TPartialNodeUpdate&& Update);
+	void UpdateSentState(FGuid const& NodeId, TOptional<uint64> StateHash);
+
+	FMZClient* MZClient;
+	std::vector<FPendingUpdate> Pending;
+	TMap<FGuid, int32> PendingByNode;
+};
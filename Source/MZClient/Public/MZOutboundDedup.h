@@ -0,0 +1,45 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+#include <mutex>
+
+enum class EMZOutboundKind : uint8
+{
+	NodeUpdate,
+	PinValue,
+	StringList,
+};
+
+// Remembers a hash of the last payload sent for every target so byte identical resends can be skipped.
+// A target is forgotten when MediaZ changes it, and everything is forgotten when the connection changes.
+class MZCLIENT_API FMZOutboundDedup
+{
+public:
+	//Returns false if Data is what was last sent for the target, otherwise records it as sent
+	bool ShouldSend(EMZOutboundKind Kind, FGuid const& Target, void const* Data, size_t Size);
+	bool ShouldSend(EMZOutboundKind Kind, FAnsiStringView Target, void const* Data, size_t Size);
+
+	//For messages that are queued before they are sent: returns false if Data is what was last sent for the target,
+	//otherwise sets OutHash to be passed to Commit once the message has actually been sent. OutHash stays unset if deduplication is off.
+	bool ShouldSendDeferred(EMZOutboundKind Kind, FGuid const& Target, void const* Data, size_t Size, TOptional<uint64>& OutHash);
+	void Commit(EMZOutboundKind Kind, FGuid const& Target, uint64 Hash);
+
+	//Any thread
+	void Invalidate(EMZOutboundKind Kind, FGuid const& Target);
+	void Reset();
+
+	std::atomic<uint64> SuppressedMessages = 0;
+	std::atomic<uint64> SuppressedBytes = 0;
+
+private:
+	bool ShouldSend(uint64 Key, void const* Data, size_t Size, bool bRecord, TOptional<uint64>& OutHash);
+	static uint64 MakeKey(EMZOutboundKind Kind, void const* Target, size_t Size);
+
+	std::mutex Guard;
+	TMap<uint64, uint64> LastSent;
+};
@@ -0,0 +1,199 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#pragma warning (disable : 4800)
+#pragma warning (disable : 4668)
+
+#include "MediaZ/AppAPI.h"
+#include <uuid.h>
+#include "MZPinPayload.h"
+
+// Bounded single-producer/single-consumer ring of pin values.
+// The gRPC thread is the only producer and the game thread is the only consumer.
+// Slots only hold references to shared payloads, so queueing a value never copies it.
+// When the consumer falls behind by a full ring the producer drops the oldest value, so the newest one always gets through.
+// Both sides claim the oldest value by advancing Tail, and the per slot sequence tells the producer when the slot is free again.
+class MZCLIENT_API PinDataQueue
+{
+public:
+	struct Sample
+	{
+		MZPinPayload Payload;
+		uint32_t FrameNumber = 0;
+	};
+
+	// Per-pin counters of the jitter buffer mode, written by the consumer and readable from any thread
+	struct JitterStats
+	{
+		std::atomic<uint64_t> OnTime = 0;
+		// Frames served while newer samples were already buffered, the buffer could be shallower
+		std::atomic<uint64_t> Early = 0;
+		// Frames whose sample did not arrive before the deadline
+		std::atomic<uint64_t> Late = 0;
+		// Samples that were superseded before being used
+		std::atomic<uint64_t> Dropped = 0;
+		std::atomic<uint32_t> Depth = 0;
+		// Smoothed difference between the newest received frame and the frame being rendered
+		std::atomic<float> ArrivalSkew = 0;
+	};
+
+	static constexpr uint32_t MaxCapacity = 1 << 16;
+
+	PinDataQueue(uint32_t Capacity, FString const& DebugName = FString());
+
+	PinDataQueue(PinDataQueue const&) = delete;
+	PinDataQueue& operator=(PinDataQueue const&) = delete;
+
+	//Producer side, returns false if the ring was full and the oldest value was dropped to make room
+	bool Enqueue(MZPinPayload const& payload, uint32_t frameNumber);
+
+	//Producer side, discards everything enqueued so far the next time the consumer touches the queue
+	void RequestReset();
+
+	//Consumer side, the returned sample stays valid until the next call.
+	//If wait is set, blocks until the requested frame arrives or FPlatformTime::Seconds() reaches waitDeadline.
+	Sample const* DiscardExcessThenDequeue(uint32_t requestedFrameNumber, bool wait, double waitDeadline);
+
+	//Consumer side, jitter buffer mode: serves the frame that is the current buffer depth behind currentFrameNumber
+	//and tunes the depth so the late frame rate stays around mediaz.JitterBuffer.TargetLateRate
+	Sample const* DequeueBuffered(uint32_t currentFrameNumber, double waitDeadline);
+
+	void DumpStats(FOutputDevice& Ar) const;
+
+	uint32_t GetCapacity() const { return Capacity; }
+
+	bool LiveNow = true;
+
+	// Oldest values dropped by the producer because the consumer fell behind by a full ring
+	std::atomic<uint64_t> Overruns = 0;
+
+	JitterStats Stats;
+
+	FString const DebugName;
+
+private:
+	friend class FMZPinDataQueueOverrunTest;
+
+	struct Slot
+	{
+		// Position + 1 once the value at position is written, position + Capacity once it was taken out
+		std::atomic<uint32_t> Sequence = 0;
+		Sample Value;
+	};
+
+	//Takes the oldest value out into out, or drops it if out is null. Returns false if the ring is empty.
+	bool Claim(Sample* out);
+	bool Dequeue();
+	bool DequeueUpTo(uint32_t requestedFrameNumber, bool wait, double waitDeadline, uint32_t& dequeuedCount);
+	void AdaptDepth();
+	void ApplyPendingReset();
+
+	uint32_t const Capacity;
+	uint32_t const Mask;
+	std::unique_ptr<Slot[]> Slots;
+
+	// Last dequeued value, keeps its payload alive until the next dequeue
+	Sample Latest;
+
+	// Jitter buffer state, consumer only
+	uint32_t Depth = 0;
+	uint32_t WindowFrames = 0;
+	uint32_t WindowLate = 0;
+	uint32_t WindowEarly = 0;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32_t> Head = 0;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32_t> Tail = 0;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<bool> ResetPending = false;
+	std::atomic<uint32_t> ResetTo = 0;
+	std::atomic<uint32_t> NewestFrame = 0;
+
+	// Only touched by the producer while the consumer is blocked on a frame
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<bool> ConsumerWaiting = false;
+	std::atomic<uint32_t> WaitingForFrame = 0;
+	std::mutex WaitMutex;
+	std::condition_variable WaitCV;
+};
+
+// Stable reference to a registered pin queue, resolved once when the portal is created
+struct PinQueueHandle
+{
+	uint32_t Index = UINT32_MAX;
+	uint32_t Generation = 0;
+
+	bool IsValid() const { return Index != UINT32_MAX; }
+};
+
+// Pin queues live in a fixed dense array so the producer and the consumer can index them without locking.
+// Id to slot lookups of the gRPC thread go through a read-mostly map that is republished on registration changes,
+// Guard only serializes the writers.
+class MZCLIENT_API PinDataQueues : public mz::app::IEventDelegates
+{
+public:
+	static constexpr uint32_t MaxPinQueues = 4096;
+
+	PinDataQueues();
+	virtual ~PinDataQueues();
+
+	//Game thread, registering the same pin again returns the same handle and increases its reference count.
+	//Values of frame ordered pins are delivered one by one, others may be coalesced to the latest value.
+	PinQueueHandle RegisterPin(mz::fb::UUID const& pinId, FString const& DebugName = FString(), bool bFrameOrdered = false);
+	//Returns true if the last registration of the pin was released
+	bool UnregisterPin(PinQueueHandle& handle);
+	void SetPinFrameOrdered(PinQueueHandle handle, bool bFrameOrdered);
+
+	//Returns an invalid handle if the pin is not registered
+	PinQueueHandle FindPin(mz::fb::UUID const& pinId);
+
+	virtual void OnPinValueChanged(mz::fb::UUID const& pinId, uint8_t const* data, size_t size, bool reset, uint32_t frameNumber) override;
+	//Queues an already received payload without copying it again, returns true if the pin is frame ordered
+	bool PushPinValue(mz::fb::UUID const& pinId, MZPinPayload const& payload, bool reset, uint32_t frameNumber);
+
+	//Returns null if there is no new value for the pin, otherwise the value stays valid until the next pop of the same pin
+	PinDataQueue::Sample const* Pop(PinQueueHandle handle, bool wait, uint32_t frameNumber, double waitDeadline = 0);
+	PinDataQueue::Sample const* PopBuffered(PinQueueHandle handle, uint32_t frameNumber, double waitDeadline);
+
+	void DumpStats(FOutputDevice& Ar);
+
+	// Values received for pins that have no registered queue
+	std::atomic<uint64_t> UnregisteredDrops = 0;
+
+private:
+	typedef std::unordered_map<uuids::uuid, uint32_t> PinIndexMap;
+
+	struct PinQueueSlot
+	{
+		std::unique_ptr<PinDataQueue> Queue;
+		uuids::uuid Id;
+		uint32_t Generation = 0;
+		uint32_t RefCount = 0;
+		std::atomic<bool> FrameOrdered = false;
+	};
+
+	template <typename F>
+	void ReadIndexMap(F&& Func)
+	{
+		ActiveReaders.fetch_add(1);
+		Func(*IndexMap.load());
+		ActiveReaders.fetch_sub(1);
+	}
+
+	//Swaps in the new map and waits until no reader can still see the old one
+	void PublishIndexMap(PinIndexMap* NewMap);
+
+	std::mutex Guard;
+	std::unique_ptr<PinQueueSlot[]> Slots;
+	std::vector<uint32_t> FreeSlots;
+	std::atomic<PinIndexMap const*> IndexMap;
+	std::atomic<uint32_t> ActiveReaders = 0;
+};
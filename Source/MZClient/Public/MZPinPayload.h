@@ -0,0 +1,39 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+// Immutable, reference counted pin value shared between the pin queues and the game thread broadcast.
+// Small payloads come from lock-free fixed size slabs so steady state traffic is served from recycled blocks.
+class MZCLIENT_API MZPinPayload
+{
+public:
+	MZPinPayload() = default;
+	MZPinPayload(uint8_t const* data, size_t size);
+
+	MZPinPayload(MZPinPayload const& other);
+	MZPinPayload(MZPinPayload&& other) noexcept;
+	MZPinPayload& operator=(MZPinPayload const& other);
+	MZPinPayload& operator=(MZPinPayload&& other) noexcept;
+	~MZPinPayload();
+
+	uint8_t const* Data() const { return Block ? reinterpret_cast<uint8_t const*>(Block + 1) : nullptr; }
+	size_t Size() const { return Block ? Block->Size : 0; }
+	bool IsEmpty() const { return Size() == 0; }
+
+	void Reset();
+
+private:
+	struct alignas(16) FBlock
+	{
+		std::atomic<int32_t> RefCount;
+		uint32_t Size;
+		uint32_t SizeClass;
+	};
+
+	FBlock* Block = nullptr;
+};
@@ -0,0 +1,152 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/Thread.h"
+#include <atomic>
+#include <mutex>
+
+#pragma warning (disable : 4800)
+#pragma warning (disable : 4668)
+
+#include "MediaZ/AppAPI.h"
+
+class FMZClient;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+enum class EMZRecordType : uint8
+{
+	PinValueChanged,
+	NodeUpdated,
+	FunctionCall,
+	ExecuteAppInfo,
+	NodeImported,
+};
+
+// Every record of a session log starts with this header, followed by Size bytes of payload padded to 8 bytes.
+// Pin values are stored as the pin id followed by the value, function calls as the node id followed by the packed function node,
+// other events as their packed table.
+struct FMZRecordHeader
+{
+	//Seconds since the recording started
+	double Time;
+	uint64 GameFrame;
+	uint32 PinFrameNumber;
+	uint32 Size;
+	EMZRecordType Type;
+	uint8 bReset;
+	uint8 Reserved[6];
+};
+static_assert(sizeof(FMZRecordHeader) == 32);
+
+// Records the events MediaZ sends to the plugin so a show's traffic can be replayed later.
+// The gRPC threads copy records into fixed size chunks, a writer thread streams the chunks to disk
+// every mediaz.Record.FlushIntervalMs, so a crash only loses the events of the last interval.
+class MZCLIENT_API MZSessionRecorder
+{
+public:
+	//"MZRC"
+	static constexpr uint32 Magic = 0x43525A4D;
+	static constexpr uint32 Version = 1;
+
+	~MZSessionRecorder();
+
+	bool Start(FString const& Filename);
+	//Writes the rest of the log, returns false if it could not be saved
+	bool Stop();
+	bool IsRecording() const { return bRecording.load(std::memory_order_relaxed); }
+
+	//Any thread
+	void RecordPinValue(mz::fb::UUID const& PinId, uint8_t const* Data, size_t Size, bool bReset, uint32_t FrameNumber);
+	void RecordNode(EMZRecordType Type, mz::fb::Node const& Node);
+	void RecordFunctionCall(mz::fb::UUID const& NodeId, mz::fb::Node const& Function);
+	void RecordExecuteAppInfo(mz::app::AppExecuteInfo const& Info);
+
+private:
+	struct FChunk
+	{
+		TArray64<uint8> Data;
+		// Bytes filled by Append, guarded by Guard
+		int64 Used = 0;
+		// Bytes already written to the file, writer thread only
+		int64 Written = 0;
+	};
+
+	void Append(EMZRecordType Type, uint32 PinFrameNumber, bool bReset, TArrayView<uint8 const> Prefix, TArrayView<uint8 const> Payload);
+	//Guard must be held, returns null if too many chunks are waiting for the disk
+	FChunk* GetChunk(int64 RecordSize);
+	void SealCurrentChunk();
+	void RunWriter();
+	void WriteChunk(FChunk& Chunk, int64 Used);
+
+	std::atomic<bool> bRecording = false;
+	std::mutex Guard;
+	TUniquePtr<FChunk> CurrentChunk;
+	// Filled chunks waiting for the writer thread
+	TArray<TUniquePtr<FChunk>> SealedChunks;
+	TArray<TUniquePtr<FChunk>> FreeChunks;
+	// Sealed chunks not written yet, including the ones the writer thread is busy with
+	int32 PendingChunks = 0;
+	int64 RecordedBytes = 0;
+	uint64 RecordCount = 0;
+	uint64 DroppedCount = 0;
+	FString Filename;
+	double StartTime = 0;
+
+	TUniquePtr<FArchive> FileWriter;
+	TUniquePtr<FThread> WriterThread;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bWriterExit = false;
+};
+
+// Feeds a recorded session back through the event delegates from its own thread, as the gRPC thread would,
+// and collects the game thread's cost of handling the events of every frame.
+// Only one thread may feed the pin queues, so a replay needs the plugin to be disconnected or on the loopback transport,
+// the connection thread is held back and events delivered by the live transport are dropped until the replay is over.
+class MZCLIENT_API MZSessionReplayer : public FRunnable
+{
+public:
+	MZSessionReplayer(FMZClient* MZClient);
+	virtual ~MZSessionReplayer();
+
+	//If bMaxSpeed is set events are dispatched as fast as possible instead of at their recorded times
+	bool Start(FString const& Filename, bool bMaxSpeed);
+	void Shutdown();
+	bool IsReplaying() const { return bReplaying.load(std::memory_order_relaxed); }
+	//The whole log was dispatched but the report was not printed yet
+	bool IsFinished() const { return Thread && !IsReplaying(); }
+	//Any thread, true if an event delegate is called by anything but the replay thread while replaying
+	bool BlocksLiveEvents() const
+	{
+		return IsReplaying() && FPlatformTLS::GetCurrentThreadId() != ReplayThreadId.load(std::memory_order_relaxed);
+	}
+
+	//Game thread, called once per tick while replaying with the time spent on MediaZ tasks
+	void RecordFrameCost(double Seconds);
+
+	virtual void Stop() override;
+
+private:
+	virtual uint32 Run() override;
+	//Returns false if the payload is not a valid record of its type
+	bool Dispatch(FMZRecordHeader const& Header, uint8 const* Payload);
+	void Report();
+
+	FMZClient* MZClient;
+	IMappedFileHandle* MappedFile = nullptr;
+	IMappedFileRegion* MappedRegion = nullptr;
+	FString Filename;
+	bool bMaxSpeed = false;
+	uint64 DispatchedCount = 0;
+	TArray<float> FrameCosts;
+
+	std::atomic<bool> bReplaying = false;
+	std::atomic<uint32> ReplayThreadId = 0;
+	std::atomic<bool> bExit = false;
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,189 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+// Layout of the shared memory segment pin values can be written to instead of sending them over gRPC.
+// This header has no engine dependencies so producers outside of Unreal can include it.
+// The plugin creates the segment and publishes its name in the root node metadata under SharedPinMemoryKey.
+// A producer claims one slot per pin and writes every value into the slot's ring, each sample is guarded by a seqlock.
+// The producer releases the slot when it stops writing the pin, the plugin reclaims it when the pin is unregistered.
+// Values larger than MaxValueSize, and pins without a slot, keep going over gRPC.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace MZSharedPins
+{
+	constexpr char const* SharedPinMemoryKey = "SharedPinMemory";
+	//"MZSP"
+	constexpr uint32_t Magic = 0x50535A4D;
+	constexpr uint32_t Version = 2;
+	constexpr uint32_t SlotCount = 256;
+	constexpr uint32_t RingSize = 8;
+	constexpr uint32_t MaxValueSize = 512;
+
+	//Low bits of Slot::State, the bits above count how often the slot was released.
+	//A claim is identified by its token, the Active state of its generation, so a producer that lost its slot
+	//can not write to it anymore once the slot was claimed again.
+	enum SlotState : uint32_t
+	{
+		Free,
+		Claiming,
+		Active,
+		//Active while the producer writes a sample, the slot can not be released meanwhile
+		Writing,
+	};
+	constexpr uint32_t StateMask = 3;
+	constexpr uint32_t GenerationStep = 4;
+
+	struct alignas(64) Sample
+	{
+		//Odd while the producer writes the sample
+		std::atomic<uint32_t> Sequence;
+		uint32_t FrameNumber;
+		uint32_t Size;
+		uint32_t Reserved;
+		uint8_t Data[MaxValueSize];
+	};
+
+	struct alignas(64) Slot
+	{
+		std::atomic<uint32_t> State;
+		uint8_t PinId[16];
+		alignas(64) std::atomic<uint64_t> WriteCount;
+		Sample Samples[RingSize];
+	};
+
+	struct alignas(64) SegmentHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t SlotCount;
+		uint32_t RingSize;
+		uint32_t MaxValueSize;
+		//Increased every time a slot is claimed or released
+		std::atomic<uint32_t> DirectoryVersion;
+	};
+
+	struct Segment
+	{
+		SegmentHeader Header;
+		Slot Slots[SlotCount];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared pin memory needs lock free 64 bit atomics");
+
+	inline void InitializeSegment(Segment& Seg)
+	{
+		std::memset(&Seg, 0, sizeof(Seg));
+		Seg.Header.SlotCount = SlotCount;
+		Seg.Header.RingSize = RingSize;
+		Seg.Header.MaxValueSize = MaxValueSize;
+		Seg.Header.Version = Version;
+		std::atomic_thread_fence(std::memory_order_release);
+		Seg.Header.Magic = Magic;
+	}
+
+	inline uint32_t GetToken(uint32_t State)
+	{
+		return (State & ~StateMask) | Active;
+	}
+
+	//Either side, true while the claim identified by Token holds the slot
+	inline bool IsClaimedBy(Slot const& S, uint32_t Token)
+	{
+		uint32_t State = S.State.load(std::memory_order_acquire);
+		return (State & StateMask) >= Active && GetToken(State) == Token;
+	}
+
+	//Producer side, returns the slot of the pin, claiming a free one if needed, or -1 if all slots are taken
+	inline int32_t ClaimSlot(Segment& Seg, uint8_t const* PinId, uint32_t& OutToken)
+	{
+		for (uint32_t i = 0; i < SlotCount; ++i)
+		{
+			Slot& S = Seg.Slots[i];
+			uint32_t State = S.State.load(std::memory_order_acquire);
+			if ((State & StateMask) >= Active && !std::memcmp(S.PinId, PinId, sizeof(S.PinId)))
+			{
+				OutToken = GetToken(State);
+				return int32_t(i);
+			}
+		}
+		for (uint32_t i = 0; i < SlotCount; ++i)
+		{
+			Slot& S = Seg.Slots[i];
+			uint32_t Expected = S.State.load(std::memory_order_relaxed);
+			if ((Expected & StateMask) == Free && S.State.compare_exchange_strong(Expected, Expected | Claiming, std::memory_order_acquire))
+			{
+				std::memcpy(S.PinId, PinId, sizeof(S.PinId));
+				//samples of the previous claim are not the pin's
+				S.WriteCount.store(0, std::memory_order_relaxed);
+				OutToken = GetToken(Expected);
+				S.State.store(OutToken, std::memory_order_release);
+				Seg.Header.DirectoryVersion.fetch_add(1, std::memory_order_release);
+				return int32_t(i);
+			}
+		}
+		return -1;
+	}
+
+	//Either side, frees the slot of the claim identified by Token.
+	//Fails while a sample is being written, or if the slot was already released.
+	inline bool ReleaseSlot(Segment& Seg, uint32_t SlotIndex, uint32_t Token)
+	{
+		uint32_t Expected = Token;
+		if (!Seg.Slots[SlotIndex].State.compare_exchange_strong(Expected, (Token & ~StateMask) + GenerationStep, std::memory_order_acq_rel))
+		{
+			return false;
+		}
+		Seg.Header.DirectoryVersion.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	//Producer side, a single producer per slot.
+	//Fails if the value is too large, or if the slot was released, then the pin has to be claimed again.
+	inline bool Write(Slot& S, uint32_t Token, void const* Data, uint32_t Size, uint32_t FrameNumber)
+	{
+		if (Size > MaxValueSize)
+		{
+			return false;
+		}
+		uint32_t Expected = Token;
+		if (!S.State.compare_exchange_strong(Expected, Token | Writing, std::memory_order_acquire))
+		{
+			return false;
+		}
+		uint64_t Index = S.WriteCount.load(std::memory_order_relaxed);
+		Sample& Smp = S.Samples[Index % RingSize];
+		uint32_t Seq = Smp.Sequence.load(std::memory_order_relaxed);
+		Smp.Sequence.store(Seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		Smp.FrameNumber = FrameNumber;
+		Smp.Size = Size;
+		std::memcpy(Smp.Data, Data, Size);
+		Smp.Sequence.store(Seq + 2, std::memory_order_release);
+		S.WriteCount.store(Index + 1, std::memory_order_release);
+		S.State.store(Token, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer side, copies sample Index of the slot, fails if it is being written or was overwritten
+	inline bool Read(Slot const& S, uint64_t Index, uint8_t* OutData, uint32_t& OutSize, uint32_t& OutFrameNumber)
+	{
+		Sample const& Smp = S.Samples[Index % RingSize];
+		uint32_t Seq = Smp.Sequence.load(std::memory_order_acquire);
+		if (Seq & 1)
+		{
+			return false;
+		}
+		OutFrameNumber = Smp.FrameNumber;
+		OutSize = Smp.Size < MaxValueSize ? Smp.Size : MaxValueSize;
+		std::memcpy(OutData, Smp.Data, OutSize);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return Smp.Sequence.load(std::memory_order_relaxed) == Seq
+			&& S.WriteCount.load(std::memory_order_acquire) - Index <= RingSize;
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MZSharedPinLayout.h"
+
+// Consumer side of the shared pin memory segment, owned by the client and read by the game thread
+class MZCLIENT_API MZSharedPinMemory
+{
+public:
+	~MZSharedPinMemory();
+
+	//Name defaults to one derived from the process id
+	bool Create(FString const& InName = FString());
+	void Release();
+	bool IsValid() const { return Segment != nullptr; }
+
+	//Name producers open the segment with, published in the root node metadata
+	FString const& GetName() const { return Name; }
+
+	//Game thread, copies the newest value of the pin written since the last read.
+	//Frame ordered pins only accept the sample of FrameNumber, anything else is left to the pin's queue.
+	bool Read(FGuid const& PinId, uint32 FrameNumber, bool bFrameOrdered, TArray<uint8>& OutValue, uint32& OutFrameNumber);
+
+	//Game thread, reclaims the slot of a pin that is not used anymore so the producer can give it to another pin
+	void ReleasePin(FGuid const& PinId);
+
+private:
+	friend class FMZSharedPinMemoryTest;
+
+	void RefreshDirectory();
+
+	struct FSlotReader
+	{
+		uint32 SlotIndex = 0;
+		uint32 Token = 0;
+		uint64 ReadCount = 0;
+	};
+
+	FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+	MZSharedPins::Segment* Segment = nullptr;
+	uint32 DirectoryVersion = 0;
+	// Readers of the slots currently claimed, rebuilt when the directory changes
+	TMap<FGuid, FSlotReader> Readers;
+	// Slots of released pins that were being written to, retried when the directory is refreshed
+	TArray<FSlotReader> PendingReleases;
+	FString Name;
+};
@@ -0,0 +1,317 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+// Bump allocator for task captures that do not fit in FMZTask's inline storage.
+// Any thread may allocate, the whole arena is rewound once no allocation is alive anymore.
+class MZCLIENT_API FMZTaskArena
+{
+public:
+	static FMZTaskArena& Get();
+
+	//Returns null if the arena is full, the caller falls back to the heap
+	void* Allocate(size_t Size, size_t Alignment);
+	void Release();
+
+	//Game thread, called after the task queues are drained
+	void ResetIfUnused();
+
+	// Callables that did not fit in FMZTask's inline storage, and the part of them that did not fit in the arena either
+	std::atomic<uint64> Allocations = 0;
+	std::atomic<uint64> HeapFallbacks = 0;
+
+private:
+	FMZTaskArena();
+	~FMZTaskArena();
+
+	static constexpr uint32 Capacity = 1 << 20;
+	uint8* Memory = nullptr;
+
+	// Live allocation count in the high 32 bits, bump offset in the low 32 bits
+	std::atomic<uint64> State = 0;
+};
+
+// Move-only replacement of std::function<void()> for the game thread task queues.
+// Callables up to InlineSize bytes with a noexcept move constructor are stored in place, others go to FMZTaskArena.
+// Use FitsInline to check a callable at compile time, misses at runtime show up in FMZTaskArena's counters.
+class MZCLIENT_API FMZTask
+{
+public:
+	static constexpr size_t InlineSize = 64;
+	static constexpr size_t InlineAlignment = 16;
+
+	template <typename F, typename T = std::decay_t<F>>
+	static constexpr bool FitsInline = sizeof(T) <= InlineSize && alignof(T) <= InlineAlignment && std::is_nothrow_move_constructible_v<T>;
+
+	FMZTask() = default;
+
+	template <typename F, typename T = std::decay_t<F>, typename = std::enable_if_t<!std::is_same_v<T, FMZTask>>>
+	FMZTask(F&& Func)
+	{
+		static_assert(std::is_invocable_v<T&>, "FMZTask needs a callable without parameters");
+		if constexpr (FitsInline<T>)
+		{
+			Callable = new (Storage) T(Forward<F>(Func));
+			Ops = &InlineOps<T>;
+		}
+		else if (void* ArenaMemory = FMZTaskArena::Get().Allocate(sizeof(T), alignof(T)))
+		{
+			Callable = new (ArenaMemory) T(Forward<F>(Func));
+			Ops = &ArenaOps<T>;
+		}
+		else
+		{
+			Callable = new (FMemory::Malloc(sizeof(T), alignof(T))) T(Forward<F>(Func));
+			Ops = &HeapOps<T>;
+		}
+	}
+
+	FMZTask(FMZTask&& Other) noexcept
+	{
+		MoveFrom(Other);
+	}
+
+	FMZTask& operator=(FMZTask&& Other) noexcept
+	{
+		if (this != &Other)
+		{
+			Reset();
+			MoveFrom(Other);
+		}
+		return *this;
+	}
+
+	FMZTask(FMZTask const&) = delete;
+	FMZTask& operator=(FMZTask const&) = delete;
+
+	~FMZTask()
+	{
+		Reset();
+	}
+
+	void operator()()
+	{
+		Ops->Invoke(Callable);
+	}
+
+	explicit operator bool() const { return Ops != nullptr; }
+
+private:
+	struct FOps
+	{
+		void (*Invoke)(void*);
+		//Only set for inline callables, moves the callable into the given storage and destroys the source
+		void (*Relocate)(void* Src, void* Dst);
+		void (*Destroy)(void*);
+	};
+
+	template <typename T>
+	static void InvokeImpl(void* Callable) { (*static_cast<T*>(Callable))(); }
+
+	template <typename T>
+	static void RelocateImpl(void* Src, void* Dst)
+	{
+		new (Dst) T(MoveTemp(*static_cast<T*>(Src)));
+		static_cast<T*>(Src)->~T();
+	}
+
+	template <typename T>
+	static void DestroyInline(void* Callable) { static_cast<T*>(Callable)->~T(); }
+
+	template <typename T>
+	static void DestroyArena(void* Callable)
+	{
+		static_cast<T*>(Callable)->~T();
+		FMZTaskArena::Get().Release();
+	}
+
+	template <typename T>
+	static void DestroyHeap(void* Callable)
+	{
+		static_cast<T*>(Callable)->~T();
+		FMemory::Free(Callable);
+	}
+
+	template <typename T>
+	static constexpr FOps InlineOps = { &InvokeImpl<T>, &RelocateImpl<T>, &DestroyInline<T> };
+	template <typename T>
+	static constexpr FOps ArenaOps = { &InvokeImpl<T>, nullptr, &DestroyArena<T> };
+	template <typename T>
+	static constexpr FOps HeapOps = { &InvokeImpl<T>, nullptr, &DestroyHeap<T> };
+
+	void MoveFrom(FMZTask& Other)
+	{
+		Ops = Other.Ops;
+		if (Ops && Ops->Relocate)
+		{
+			Ops->Relocate(Other.Callable, Storage);
+			Callable = Storage;
+		}
+		else
+		{
+			Callable = Other.Callable;
+		}
+		Other.Ops = nullptr;
+		Other.Callable = nullptr;
+	}
+
+	void Reset()
+	{
+		if (Ops)
+		{
+			Ops->Destroy(Callable);
+			Ops = nullptr;
+			Callable = nullptr;
+		}
+	}
+
+	alignas(InlineAlignment) uint8 Storage[InlineSize];
+	void* Callable = nullptr;
+	FOps const* Ops = nullptr;
+};
+
+// Preallocated multi-producer/single-consumer ring for the game thread tasks.
+// Producers claim a slot by advancing Head and publish it with the slot's sequence number, so queueing does not allocate.
+// If the ring is full, items go to a locked overflow queue until the consumer has emptied it, which keeps the order.
+template <typename T>
+class TMZMpscRing
+{
+public:
+	explicit TMZMpscRing(uint32 InCapacity)
+		: Capacity(FMath::RoundUpToPowerOfTwo(FMath::Max(InCapacity, 2u)))
+		, Mask(Capacity - 1)
+		, Slots(std::make_unique<FSlot[]>(Capacity))
+	{
+		for (uint32 i = 0; i < Capacity; ++i)
+		{
+			Slots[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	TMZMpscRing(TMZMpscRing const&) = delete;
+	TMZMpscRing& operator=(TMZMpscRing const&) = delete;
+
+	//Any thread
+	void Enqueue(T&& Item)
+	{
+		if (!Overflowing.load(std::memory_order_acquire) && TryEnqueue(Item))
+		{
+			return;
+		}
+
+		std::scoped_lock<std::mutex> Lock(OverflowMutex);
+		//the consumer may have emptied the overflow queue in the meantime
+		if (!Overflowing.load(std::memory_order_relaxed) && TryEnqueue(Item))
+		{
+			return;
+		}
+		Overflowing.store(true, std::memory_order_release);
+		Overflow.Enqueue(MoveTemp(Item));
+		Overflows.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Consumer only, returns the oldest item which stays valid until Pop
+	T* Peek()
+	{
+		FSlot& Slot = Slots[Tail & Mask];
+		if (Slot.Sequence.load(std::memory_order_acquire) == Tail + 1)
+		{
+			PeekedOverflow = false;
+			return &Slot.Item;
+		}
+		if (!Overflowing.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+
+		PeekedOverflow = true;
+		if (T* Item = Overflow.Peek())
+		{
+			return Item;
+		}
+		std::scoped_lock<std::mutex> Lock(OverflowMutex);
+		if (T* Item = Overflow.Peek())
+		{
+			return Item;
+		}
+		Overflowing.store(false, std::memory_order_release);
+		return nullptr;
+	}
+
+	//Consumer only, removes the item returned by the last Peek
+	void Pop()
+	{
+		if (PeekedOverflow)
+		{
+			Overflow.Pop();
+			return;
+		}
+		FSlot& Slot = Slots[Tail & Mask];
+		Slot.Item = T();
+		Slot.Sequence.store(Tail + Capacity, std::memory_order_release);
+		++Tail;
+	}
+
+	uint32 GetCapacity() const { return Capacity; }
+
+	// Items that went to the overflow queue because the ring was full
+	std::atomic<uint64> Overflows = 0;
+
+private:
+	struct FSlot
+	{
+		std::atomic<uint64> Sequence = 0;
+		T Item;
+	};
+
+	bool TryEnqueue(T& Item)
+	{
+		uint64 Pos = Head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			FSlot& Slot = Slots[Pos & Mask];
+			int64 Diff = int64(Slot.Sequence.load(std::memory_order_acquire)) - int64(Pos);
+			if (Diff == 0)
+			{
+				if (Head.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				{
+					Slot.Item = MoveTemp(Item);
+					Slot.Sequence.store(Pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (Diff < 0)
+			{
+				//the consumer has not freed this slot yet
+				return false;
+			}
+			else
+			{
+				Pos = Head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint32 const Capacity;
+	uint64 const Mask;
+	std::unique_ptr<FSlot[]> Slots;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Head = 0;
+	// Consumer only
+	alignas(PLATFORM_CACHE_LINE_SIZE) uint64 Tail = 0;
+	bool PeekedOverflow = false;
+
+	// Producers are serialized by OverflowMutex, so a single producer queue is enough
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<bool> Overflowing = false;
+	std::mutex OverflowMutex;
+	TQueue<T, EQueueMode::Spsc> Overflow;
+};
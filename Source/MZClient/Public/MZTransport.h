@@ -0,0 +1,54 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#pragma warning (disable : 4800)
+#pragma warning (disable : 4668)
+
+#include "MediaZ/AppAPI.h"
+
+// Everything the plugin sends to MediaZ goes through this interface.
+// Method names follow mz::app::IAppServiceClient so call sites read the same for either implementation.
+class MZCLIENT_API IMZTransport
+{
+public:
+	virtual ~IMZTransport() = default;
+
+	virtual void RegisterEventDelegates(mz::app::IEventDelegates* EventDelegates) = 0;
+	//Blocks until the connection attempt is finished, only called from the connection thread
+	virtual void TryConnect() = 0;
+	virtual bool IsConnected() = 0;
+
+	virtual void Send(mz::app::AppEvent const& Event) = 0;
+	virtual void SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update) = 0;
+	virtual void SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs) = 0;
+	virtual void SendContextMenuUpdate(mz::ContextMenuUpdate const& Update) = 0;
+	virtual void NotifyPinValueChanged(mz::PinValueChanged const& Value) = 0;
+	virtual void UpdateStringList(mz::app::UpdateStringList const& List) = 0;
+};
+
+// Transport of the MediaZ SDK, owns the app service client of one endpoint
+class MZCLIENT_API FMZSDKTransport : public IMZTransport
+{
+public:
+	FMZSDKTransport(FString const& Endpoint, FString const& AppKey);
+	virtual ~FMZSDKTransport();
+
+	virtual void RegisterEventDelegates(mz::app::IEventDelegates* EventDelegates) override;
+	virtual void TryConnect() override;
+	virtual bool IsConnected() override;
+
+	virtual void Send(mz::app::AppEvent const& Event) override;
+	virtual void SendPartialNodeUpdate(mz::PartialNodeUpdate const& Update) override;
+	virtual void SendPinShowAsChange(mz::fb::UUID const& PinId, mz::fb::ShowAs ShowAs) override;
+	virtual void SendContextMenuUpdate(mz::ContextMenuUpdate const& Update) override;
+	virtual void NotifyPinValueChanged(mz::PinValueChanged const& Value) override;
+	virtual void UpdateStringList(mz::app::UpdateStringList const& List) override;
+
+private:
+	mz::app::IAppServiceClient* Client = nullptr;
+};
@@ -34,7 +34,7 @@ bool FMZLicenseManager::UpdateFeature(bool registerFeature, AActor* actor, UScen
 		if(MZSceneTreeManager.MZPropertyManager.PropertyToPortalPin.Contains(mzprop->Id))
 		{
 			auto portalId = MZSceneTreeManager.MZPropertyManager.PropertyToPortalPin.FindRef(mzprop->Id);
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			//// TODO: find a way to get a build time
 			auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateFeatureRegistrationUpdateDirect(mb, (mz::fb::UUID*)&portalId, TCHAR_TO_UTF8(*featureName), !registerFeature, count, TCHAR_TO_UTF8(*message), buildTime));
 			mb.Finish(offset);
@@ -10,6 +10,20 @@
 #include "MZSceneTreeManager.h"
 #include "PropertyEditorModule.h"
 
+static TAutoConsoleVariable<bool> CVarTrackPrediction(TEXT("mediaz.TrackPrediction"), false, TEXT("Extrapolate track input pins with constant velocity when the sample of a frame is missing"));
+static TAutoConsoleVariable<int32> CVarTrackPredictionMaxFrames(TEXT("mediaz.TrackPrediction.MaxFrames"), 3, TEXT("Number of consecutive missing frames a track is extrapolated for before the last value is held"));
+
+static std::atomic<uint64> TotalPredictedTrackFrames = 0;
+static std::atomic<uint64> TotalReceivedTrackFrames = 0;
+
+static FAutoConsoleCommandWithOutputDevice TrackPredictionStatsCommand(
+	TEXT("mediaz.TrackPrediction.Stats"),
+	TEXT("Prints how many track frames were received and how many were predicted"),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			Ar.Logf(TEXT("Track frames received: %llu, predicted: %llu"), TotalReceivedTrackFrames.load(), TotalPredictedTrackFrames.load());
+		}));
+
 #define CHECK_PROP_SIZE() {if (size != Property->ElementSize){UE_LOG(LogMZSceneTreeManager, Error, TEXT("Property size mismatch with mediaZ"));return;}}
 
 bool PropertyVisibleExp(FProperty* ueproperty)
@@ -298,6 +312,69 @@ void MZTrackProperty::SetPropValue_Internal(void* val, size_t size, uint8* custo
 
 }
 
+FMZTrack* MZTrackProperty::GetTrackData()
+{
+	void* container = nullptr;
+	if (ComponentContainer) container = ComponentContainer.Get();
+	else if (ActorContainer) container = ActorContainer.Get();
+	else if (ObjectPtr && IsValid(ObjectPtr)) container = ObjectPtr;
+	else if (StructPtr) container = StructPtr;
+
+	return container ? structprop->ContainerPtrToValuePtr<FMZTrack>(container) : nullptr;
+}
+
+void MZTrackProperty::RecordSample(uint32_t FrameNumber)
+{
+	FMZTrack* TrackData = GetTrackData();
+	if (!TrackData)
+	{
+		return;
+	}
+
+	if (HistoryCount == 0 || History[1].FrameNumber != FrameNumber)
+	{
+		History[0] = History[1];
+		HistoryCount = FMath::Min(HistoryCount + 1, 2u);
+	}
+	History[1] = { FrameNumber, TrackData->location, TrackData->rotation, TrackData->fov, TrackData->focus_distance };
+	MissedFrames = 0;
+	TotalReceivedTrackFrames++;
+}
+
+bool MZTrackProperty::PredictMissingSample()
+{
+	if (!CVarTrackPrediction.GetValueOnGameThread() || HistoryCount < 2 || MissedFrames >= (uint32)FMath::Max(CVarTrackPredictionMaxFrames.GetValueOnGameThread(), 0))
+	{
+		return false;
+	}
+
+	TrackSample const& Prev = History[0];
+	TrackSample const& Last = History[1];
+	int32 Span = int32(Last.FrameNumber - Prev.FrameNumber);
+	FMZTrack* TrackData = GetTrackData();
+	if (Span <= 0 || !TrackData)
+	{
+		return false;
+	}
+
+	MissedFrames++;
+	double Alpha = double(MissedFrames) / Span;
+	TrackData->location = Last.Location + (Last.Location - Prev.Location) * Alpha;
+	//go through the shortest arc so a wrap around 180 degrees does not spin the camera
+	TrackData->rotation = FVector(
+		Last.Rotation.X + FMath::FindDeltaAngleDegrees(Prev.Rotation.X, Last.Rotation.X) * Alpha,
+		Last.Rotation.Y + FMath::FindDeltaAngleDegrees(Prev.Rotation.Y, Last.Rotation.Y) * Alpha,
+		Last.Rotation.Z + FMath::FindDeltaAngleDegrees(Prev.Rotation.Z, Last.Rotation.Z) * Alpha);
+	TrackData->fov = Last.Fov + (Last.Fov - Prev.Fov) * Alpha;
+	TrackData->focus_distance = Last.FocusDistance + (Last.FocusDistance - Prev.FocusDistance) * Alpha;
+
+	IsChanged = true;
+	MarkState();
+	PredictedFrames++;
+	TotalPredictedTrackFrames++;
+	return true;
+}
+
 void MZTrackProperty::SetProperty_InCont(void* container, void* val)
 {
 	auto track = flatbuffers::GetRoot<mz::fb::Track>(val);
@@ -375,7 +452,7 @@ std::vector<uint8> MZTransformProperty::UpdatePinValue(uint8* customContainer)
 	if (container)
 	{
 		FTransform TransformData = *Property->ContainerPtrToValuePtr<FTransform>(container);
-		flatbuffers::FlatBufferBuilder fb;
+		FMZFlatBufferBuilder fb;
 		mz::fb::Transform TempTransform;
 		TempTransform.mutable_position() = mz::fb::vec3d(TransformData.GetLocation().X, TransformData.GetLocation().Y, TransformData.GetLocation().Z);
 		TempTransform.mutable_scale() = mz::fb::vec3d(TransformData.GetScale3D().X, TransformData.GetScale3D().Y, TransformData.GetScale3D().Z);
@@ -438,7 +515,7 @@ std::vector<uint8> MZTrackProperty::UpdatePinValue(uint8* customContainer)
 	{
 		FMZTrack TrackData = *Property->ContainerPtrToValuePtr<FMZTrack>(container);
 		
-		flatbuffers::FlatBufferBuilder fb;
+		FMZFlatBufferBuilder fb;
 		mz::fb::TTrack TempTrack;
 		TempTrack.location = mz::fb::vec3(TrackData.location.X, TrackData.location.Y, TrackData.location.Z);
 		TempTrack.rotation = mz::fb::vec3(TrackData.rotation.X, TrackData.rotation.Y, TrackData.rotation.Z);
@@ -773,7 +850,7 @@ std::vector<uint8> MZObjectProperty::UpdatePinValue(uint8* customContainer)
 		if (MZTextureShareManager::GetInstance()->UpdateTexturePin(this, texture))
 			{
 			// data = mz::Buffer::From(texture);
-			flatbuffers::FlatBufferBuilder fb;
+			FMZFlatBufferBuilder fb;
 			auto offset = mz::fb::CreateTexture(fb, &texture);
 			fb.Finish(offset);
 			mz::Buffer buffer = fb.Release();
@@ -39,14 +39,13 @@ uint32 MZGPUFailSafeRunnable::Run()
 					TextureManager->ExecutionState = mz::app::ExecutionState::IDLE;
 					for(int i = 0; i < 5; i++)
 					{
-						TextureManager->InputFence->Signal(UINT64_MAX);
-						TextureManager->OutputFence->Signal(UINT64_MAX);
+						TextureManager->SignalAllFences(UINT64_MAX);
 						FPlatformProcess::Sleep(0.2);
 					}
 				}
 				if(MZSceneTreeManager->MZClient)
 				{
-					flatbuffers::FlatBufferBuilder mb;
+					FMZFlatBufferBuilder mb;
 					auto offset = mz::CreateAppEventOffset(mb ,mz::app::CreateRecoverSync(mb, (mz::fb::UUID*)&FMZClient::NodeId));
 					mb.Finish(offset);
 					auto buf = mb.Release();
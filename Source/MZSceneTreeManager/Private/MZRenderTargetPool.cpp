@@ -0,0 +1,183 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "MZRenderTargetPool.h"
+#include "MZTextureShareManager.h"
+
+#include "D3D12RHIPrivate.h"
+#include "D3D12RHI.h"
+#include "D3D12Resources.h"
+#include "ID3D12DynamicRHI.h"
+
+static TAutoConsoleVariable<int32> CVarRenderTargetPoolMaxFree(TEXT("mediaz.RenderTargetPool.MaxFree"), 8, TEXT("Free shared render targets kept for reuse by texture pins, more are destroyed"));
+static TAutoConsoleVariable<int32> CVarRenderTargetPoolConfirmFrames(TEXT("mediaz.RenderTargetPool.ConfirmFrames"), 2, TEXT("Frames MediaZ has to finish after the pin update that dropped a shared render target was sent, before the target is reused"));
+
+static FAutoConsoleCommandWithOutputDevice RenderTargetPoolStatsCommand(
+	TEXT("mediaz.RenderTargetPoolStats"),
+	TEXT("Prints how often shared render targets of texture pins were reused or created."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+		{
+			MZTextureShareManager::GetInstance()->RenderTargetPool.DumpStats(Ar);
+		}));
+
+void FMZRenderTargetPool::Initialize(ID3D12Device* InDevice, MZTextureShareManager* InOwner)
+{
+	Device = InDevice;
+	Owner = InOwner;
+	MZ_D3D12_ASSERT_SUCCESS(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&ReleaseFence)));
+}
+
+UTextureRenderTarget2D* FMZRenderTargetPool::Acquire(FKey const& Key, FLinearColor const& ClearColor, FString const& DebugName, HANDLE& OutHandle)
+{
+	TArray<UTextureRenderTarget2D*>* Free = FreeTargets.Find(Key);
+	if (!Free || Free->IsEmpty())
+	{
+		Misses++;
+		return Create(Key, ClearColor, DebugName, OutHandle);
+	}
+	Hits++;
+	FreeCount--;
+	UTextureRenderTarget2D* Target = Free->Pop(false);
+	Target->ClearColor = ClearColor;
+	OutHandle = Targets[Target].Handle;
+	return Target;
+}
+
+void FMZRenderTargetPool::Release(UTextureRenderTarget2D* Target)
+{
+	if (!Target || !Targets.Contains(Target))
+	{
+		return;
+	}
+	//signaled on the GPU after everything already enqueued, the copies of this frame included
+	uint64 Value = ++LastReleaseValue;
+	ENQUEUE_RENDER_COMMAND(FMZRenderTargetPool_Release)(
+		[Fence = ReleaseFence, Value](FRHICommandListImmediate& RHICmdList)
+		{
+			RHICmdList.EnqueueLambda([Fence, Value](FRHICommandList& ExecutingCmdList)
+			{
+				GetID3D12DynamicRHI()->RHISignalManualFence(ExecutingCmdList, Fence, Value);
+			});
+		});
+	PendingReleases.Add({ Target, Value });
+}
+
+void FMZRenderTargetPool::Tick()
+{
+	if (!PendingReleases.IsEmpty())
+	{
+		uint64 Completed = ReleaseFence->GetCompletedValue();
+		//frames from here on start after every pin update queued so far went out
+		bool bUpdatesSent = !Owner->MZClient->NodeUpdates.HasPending();
+		uint64 ConfirmFrame = Owner->FrameCounter + FMath::Max(CVarRenderTargetPoolConfirmFrames.GetValueOnGameThread(), 0);
+		for (int32 i = 0; i < PendingReleases.Num();)
+		{
+			FPendingRelease& Pending = PendingReleases[i];
+			if (!Pending.ConfirmFrame && bUpdatesSent)
+			{
+				Pending.ConfirmFrame = ConfirmFrame;
+			}
+			if (Pending.FenceValue > Completed || !Pending.ConfirmFrame || !IsConfirmed(*Pending.ConfirmFrame))
+			{
+				++i;
+				continue;
+			}
+			FreeTargets.FindOrAdd(Targets[Pending.Target].Key).Add(Pending.Target);
+			FreeCount++;
+			PendingReleases.RemoveAt(i, 1, false);
+		}
+	}
+
+	int32 MaxFree = FMath::Max(CVarRenderTargetPoolMaxFree.GetValueOnGameThread(), 0);
+	for (auto It = FreeTargets.CreateIterator(); It && FreeCount > MaxFree; ++It)
+	{
+		while (!It.Value().IsEmpty() && FreeCount > MaxFree)
+		{
+			Destroy(It.Value().Pop(false));
+			FreeCount--;
+		}
+		if (It.Value().IsEmpty())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FMZRenderTargetPool::ResetConfirmFrames()
+{
+	for (FPendingRelease& Pending : PendingReleases)
+	{
+		Pending.ConfirmFrame.Reset();
+	}
+}
+
+bool FMZRenderTargetPool::IsConfirmed(uint64 Frame) const
+{
+	//outside of synced execution MediaZ does not signal the fences, the frames only have to pass here.
+	//Leaving synced execution signals the fences to the maximum, so nothing waits on those either.
+	if (Owner->ExecutionState != mz::app::ExecutionState::SYNCED && Owner->FrameCounter >= Frame)
+	{
+		return true;
+	}
+	//the pin might have changed direction since MediaZ last used the target, so both have to pass the frame
+	for (EMZCopyDirection Direction : { EMZCopyDirection::Input, EMZCopyDirection::Output })
+	{
+		FMZFenceOp Op = Owner->FenceSchedule->GetRemoteSignal(Direction, Frame);
+		ID3D12Fence* Fence = Owner->GetFence(Op.Fence);
+		if (Fence && Fence->GetCompletedValue() < Op.Value)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+UTextureRenderTarget2D* FMZRenderTargetPool::Create(FKey const& Key, FLinearColor const& ClearColor, FString const& DebugName, HANDLE& OutHandle)
+{
+	UTextureRenderTarget2D* NewRenderTarget2D = NewObject<UTextureRenderTarget2D>(GetTransientPackage(), *(DebugName + FGuid::NewGuid().ToString()), RF_MarkAsRootSet);
+	check(NewRenderTarget2D);
+	NewRenderTarget2D->RenderTargetFormat = Key.Format;
+	NewRenderTarget2D->ClearColor = ClearColor;
+	NewRenderTarget2D->bAutoGenerateMips = 0;
+	NewRenderTarget2D->bCanCreateUAV = true;
+	NewRenderTarget2D->bGPUSharedFlag = true;
+	NewRenderTarget2D->InitAutoFormat(Key.Width, Key.Height);
+	NewRenderTarget2D->UpdateResourceImmediate(true);
+	//only a new target needs its RHI resource right away, to create the shared handle
+	FlushRenderingCommands();
+
+	auto rt = NewRenderTarget2D->GameThread_GetRenderTargetResource();
+	auto RHIResource = rt ? rt->GetTexture2DRHI() : nullptr;
+	if (!RHIResource || !RHIResource->IsValid())
+	{
+		NewRenderTarget2D->RemoveFromRoot();
+		NewRenderTarget2D->MarkAsGarbage();
+		return nullptr;
+	}
+	FRHITexture* RHITexture = RHIResource;
+	FD3D12Texture* Result((FD3D12Texture*)RHITexture->GetTextureBaseRHI());
+
+	ID3D12Resource* DXResource = Result->GetResource()->GetResource();
+	DXResource->SetName(*DebugName);
+
+	MZ_D3D12_ASSERT_SUCCESS(Device->CreateSharedHandle(DXResource, 0, GENERIC_ALL, 0, &OutHandle));
+	Targets.Add(NewRenderTarget2D, { Key, OutHandle });
+	return NewRenderTarget2D;
+}
+
+void FMZRenderTargetPool::Destroy(UTextureRenderTarget2D* Target)
+{
+	FPooledTarget Pooled;
+	if (Targets.RemoveAndCopyValue(Target, Pooled))
+	{
+		::CloseHandle(Pooled.Handle);
+	}
+	//the fence already passed, so the resource is released without waiting for the render thread
+	Target->ReleaseResource();
+	Target->RemoveFromRoot();
+	Target->MarkAsGarbage();
+}
+
+void FMZRenderTargetPool::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("%d render targets, %d free, %d waiting for the GPU or MediaZ, %llu reused, %llu created"), Targets.Num(), FreeCount, PendingReleases.Num(), Hits, Misses);
+}
@@ -18,6 +18,7 @@
 #include "HardwareInfo.h"
 #include "LevelSequence.h"
 #include "PacketHandler.h"
+#include "Misc/App.h"
 
 DEFINE_LOG_CATEGORY(LogMZSceneTreeManager);
 #define LOG(x) UE_LOG(LogMZSceneTreeManager, Display, TEXT(x))
@@ -29,6 +30,7 @@ IMPLEMENT_MODULE(FMZSceneTreeManager, MZSceneTreeManager)
 UWorld* FMZSceneTreeManager::daWorld = nullptr;
 
 static TAutoConsoleVariable<int32> CVarReloadLevelFrameCount(TEXT("mediaz.ReloadFrameCount"), 10, TEXT("Reload frame count"));
+static TAutoConsoleVariable<float> CVarPinWaitBudget(TEXT("mediaz.PinWaitBudget"), 0.5f, TEXT("Fraction of the frame time the game thread may block waiting for frame-numbered input pins, shared by all pins of a frame"));
 
 #define MZ_POPULATE_UNREAL_FUNCTIONS //uncomment if you want to see functions 
 
@@ -128,6 +130,7 @@ void FMZSceneTreeManager::OnBeginFrame()
 
 void FMZSceneTreeManager::OnEndFrame()
 {
+	MZClient->NodeUpdates.Flush();
 	MZPropertyManager.OnEndFrame();
 	MZTextureShareManager::GetInstance()->OnEndFrame();
 }
@@ -153,6 +156,12 @@ void FMZSceneTreeManager::StartupModule()
 	MZViewportManager = &FModuleManager::LoadModuleChecked<FMZViewportManager>("MZViewportManager");
 
 	MZPropertyManager.MZClient = MZClient;
+	MZClient->NodeUpdates.GetParentId = [this](FGuid const& NodeId)
+		{
+			TreeNode* Node = SceneTree.GetNode(NodeId);
+			return Node && Node->Parent ? Node->Parent->Id : FGuid();
+		};
+	MZTextureShareManager::GetInstance()->OnRingHandlesChanged = [this](MZProperty* MzProperty) { SendRingHandlesChanged(MzProperty); };
 
 	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FMZSceneTreeManager::Tick));
 	MZActorManager = new FMZActorManager(SceneTree);
@@ -285,6 +294,11 @@ void FMZSceneTreeManager::StartupModule()
 
 void FMZSceneTreeManager::ShutdownModule()
 {
+	if (MZClient)
+	{
+		MZClient->NodeUpdates.GetParentId = nullptr;
+	}
+	MZTextureShareManager::GetInstance()->OnRingHandlesChanged = nullptr;
 	LOG("MZSceneTreeManager module successfully shut down.");
 }
 
@@ -307,11 +321,16 @@ void FMZSceneTreeManager::OnMZConnected(mz::fb::Node const* appNode)
 	}
 		
 	SceneTree.Root->Id = *(FGuid*)appNode->id();
+	//producers that can write to shared memory find the segment through the root metadata
+	if (MZClient->SharedPins.IsValid())
+	{
+		SceneTree.Root->mzMetaData.Add(FString(MZSharedPins::SharedPinMemoryKey), MZClient->SharedPins.GetName());
+	}
 	//add executable path
 	if(appNode->pins() && appNode->pins()->size() > 0)
 	{
 		std::vector<flatbuffers::Offset<mz::PartialPinUpdate>> PinUpdates;
-		flatbuffers::FlatBufferBuilder fb1;
+		FMZFlatBufferBuilder fb1;
 		for (auto pin : *appNode->pins())
 		{
 			PinUpdates.push_back(mz::CreatePartialPinUpdate(fb1, pin->id(), 0, mz::fb::CreateOrphanStateDirect(fb1, true, "Binding in progress")));
@@ -320,7 +339,7 @@ void FMZSceneTreeManager::OnMZConnected(mz::fb::Node const* appNode)
 		fb1.Finish(offset);
 		auto buf = fb1.Release();
 		auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 	}
 	RescanScene();
 	SendNodeUpdate(FMZClient::NodeId, false);
@@ -443,10 +462,7 @@ void FMZSceneTreeManager::OnMZPinValueChanged(mz::fb::UUID const& pinId, uint8_t
 	if (CustomProperties.Contains(Id))
 	{
 		auto mzprop = CustomProperties.FindRef(Id);
-		std::vector<uint8_t> copy(size, 0);
-		memcpy(copy.data(), data, size);
-
-		mzprop->SetPropValue((void*)copy.data(), size);
+		mzprop->SetPropValue((void*)data, size);
 		return;
 	}
 	SetPropertyValue(Id, (void*)data, size);
@@ -480,6 +496,8 @@ void FMZSceneTreeManager::OnMZPinShowAsChanged(mz::fb::UUID const& Id, mz::fb::S
 			{
 				auto& Portal = MZPropertyManager.PortalPinsById.FindChecked(PortalId);
 				Portal.ShowAs = newShowAs;
+				MZPropertyManager.UpdatePortalQueueOrdering(Portal);
+				MZClient->NodeUpdates.Flush();
 				MZClient->AppServiceClient->SendPinShowAsChange(reinterpret_cast<mz::fb::UUID&>(PortalId), newShowAs);
 				MZTextureShareManager::GetInstance()->UpdatePinShowAs(MzProperty.Get(), newShowAs);
 			}
@@ -489,14 +507,16 @@ void FMZSceneTreeManager::OnMZPinShowAsChanged(mz::fb::UUID const& Id, mz::fb::S
 	{
 		auto Portal = MZPropertyManager.PortalPinsById.Find(pinId);
 		Portal->ShowAs = newShowAs;
+		MZPropertyManager.UpdatePortalQueueOrdering(*Portal);
 		if(MZPropertyManager.PropertiesById.Contains(Portal->SourceId))
 		{
 			auto MzProperty = MZPropertyManager.PropertiesById.FindRef(Portal->SourceId);
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			auto offset = mz::CreateAppEventOffset(mb ,mz::CreatePinShowAsChanged(mb, (mz::fb::UUID*)&Portal->SourceId, newShowAs));
 			mb.Finish(offset);
 			auto buf = mb.Release();
 			auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
+			MZClient->NodeUpdates.Flush();
 			MZClient->AppServiceClient->Send(*root);
 			MZTextureShareManager::GetInstance()->UpdatePinShowAs(MzProperty.Get(), newShowAs);
 		}
@@ -563,7 +583,7 @@ void FMZSceneTreeManager::OnMZContextMenuRequested(mz::ContextMenuRequest const&
 			{
 				return;
 			}
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			std::vector<flatbuffers::Offset<mz::ContextMenuItem>> actions = menuActions.SerializeActorMenuItems(mb);
 			auto posx = mz::fb::vec2(pos.X, pos.Y);
 			auto offset = mz::CreateContextMenuUpdateDirect(mb, (mz::fb::UUID*)&itemId, &posx, instigator, &actions);
@@ -577,7 +597,7 @@ void FMZSceneTreeManager::OnMZContextMenuRequested(mz::ContextMenuRequest const&
 	{
 		auto MzProperty = MZPropertyManager.PortalPinsById.FindRef(itemId);
 		
-		flatbuffers::FlatBufferBuilder mb;
+		FMZFlatBufferBuilder mb;
 		std::vector<flatbuffers::Offset<mz::ContextMenuItem>> actions = menuActions.SerializePortalPropertyMenuItems(mb);
 		auto posx = mz::fb::vec2(pos.X, pos.Y);
 		auto offset = mz::CreateContextMenuUpdateDirect(mb, (mz::fb::UUID*)&itemId, &posx, instigator, &actions);
@@ -890,7 +910,7 @@ void FMZSceneTreeManager::OnMZNodeImported(mz::fb::Node const& appNode)
 	auto node = &appNode;
 
 	std::vector<flatbuffers::Offset<mz::PartialPinUpdate>> PinUpdates;
-	flatbuffers::FlatBufferBuilder fb1;
+	FMZFlatBufferBuilder fb1;
 	if(node->pins() && node->pins()->size() > 0)
 	{
 		for (auto pin : *node->pins())
@@ -902,14 +922,14 @@ void FMZSceneTreeManager::OnMZNodeImported(mz::fb::Node const& appNode)
 	fb1.Finish(offset);
 	auto buf = fb1.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
-	flatbuffers::FlatBufferBuilder fb3;
+	FMZFlatBufferBuilder fb3;
 	auto offset2 = mz::CreatePartialNodeUpdateDirect(fb3, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::CLEAR_FUNCTIONS | mz::ClearFlags::CLEAR_NODES);
 	fb3.Finish(offset2);
 	auto buf2 = fb3.Release();
 	auto root2 = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf2.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 
 	std::vector<const mz::fb::Node*> nodesWithProperty;
@@ -1124,7 +1144,7 @@ void FMZSceneTreeManager::OnMZNodeImported(mz::fb::Node const& appNode)
 	SendNodeUpdate(FMZClient::NodeId, false);
 
 	PinUpdates.clear();
-	flatbuffers::FlatBufferBuilder fb2;
+	FMZFlatBufferBuilder fb2;
 	std::vector<MZPortal> NewPortals;
 	for (auto const& update : updates)
 	{
@@ -1184,10 +1204,12 @@ void FMZSceneTreeManager::OnMZNodeImported(mz::fb::Node const& appNode)
 				NewPortal.CategoryName = MzProperty->CategoryName;
 				NewPortal.ShowAs = update.pinShowAs;
 
+				MZPropertyManager.RegisterPortalQueue(NewPortal, MzProperty.Get());
 				MZPropertyManager.PortalPinsById.Add(NewPortal.Id, NewPortal);
 				MZPropertyManager.PropertyToPortalPin.Add(MzProperty->Id, NewPortal.Id);
 				NewPortals.push_back(NewPortal);
 				MZTextureShareManager::GetInstance()->UpdatePinShowAs(MzProperty.Get(), update.pinShowAs);
+				MZClient->NodeUpdates.Flush();
 				MZClient->AppServiceClient->SendPinShowAsChange((mz::fb::UUID&)MzProperty->Id, update.pinShowAs);
 			}
 			
@@ -1211,19 +1233,20 @@ void FMZSceneTreeManager::OnMZNodeImported(mz::fb::Node const& appNode)
 		fb2.Finish(offset3);
 		auto buf3 = fb2.Release();
 		auto root3 = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf3.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root3);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root3);
 	}
 	for (auto& Portal : NewPortals)
 	{
 		if(MZPropertyManager.PropertiesById.Contains(Portal.SourceId))
 		{
-			flatbuffers::FlatBufferBuilder fb4;
+			FMZFlatBufferBuilder fb4;
 			auto SourceProperty = MZPropertyManager.PropertiesById.FindRef(Portal.SourceId);
 			auto UpdatedMetadata = SourceProperty->SerializeMetaData(fb4);
 			auto offset4 = mz::CreateAppEventOffset(fb4, mz::app::CreatePinMetadataUpdateDirect(fb4, (mz::fb::UUID*)&Portal.Id, &UpdatedMetadata  ,true));
 			fb4.Finish(offset4);
 			auto buf4 = fb4.Release();
 			auto root4 = flatbuffers::GetRoot<mz::app::AppEvent>(buf4.data());
+			MZClient->NodeUpdates.Flush();
 			MZClient->AppServiceClient->Send(*root4);
 		}
 	}
@@ -1287,7 +1310,7 @@ void FMZSceneTreeManager::RescanScene(bool reset)
 
 	UWorld* World = FMZSceneTreeManager::daWorld;
 
-	flatbuffers::FlatBufferBuilder fbb;
+	FMZFlatBufferBuilder fbb;
 	std::vector<flatbuffers::Offset<mz::fb::Node>> actorNodes;
 	TArray<AActor*> ActorsInScene;
 	if (IsValid(World))
@@ -1679,7 +1702,7 @@ void FMZSceneTreeManager::SendNodeUpdate(FGuid nodeId, bool bResetRootPins)
 	{
 		if (!bResetRootPins)
 		{
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = SceneTree.Root->SerializeChildren(mb);
 			std::vector<flatbuffers::Offset<mz::fb::Node>> graphFunctions;
 			for (auto& [_, cfunc] : CustomFunctions)
@@ -1691,13 +1714,18 @@ void FMZSceneTreeManager::SendNodeUpdate(FGuid nodeId, bool bResetRootPins)
 			auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&nodeId, mz::ClearFlags::CLEAR_FUNCTIONS | mz::ClearFlags::CLEAR_NODES, 0, 0, 0, &graphFunctions, 0, &graphNodes, 0, 0, &metadata);
 			mb.Finish(offset);
 			auto buf = mb.Release();
+			TOptional<uint64> stateHash;
+			if (!MZClient->OutboundDedup.ShouldSendDeferred(EMZOutboundKind::NodeUpdate, nodeId, buf.data(), buf.size(), stateHash))
+			{
+				return;
+			}
 			auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-			MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+			MZClient->NodeUpdates.SendPartialNodeUpdate(*root, stateHash);
 
 			return;
 		}
 
-		flatbuffers::FlatBufferBuilder mb = flatbuffers::FlatBufferBuilder();
+		FMZFlatBufferBuilder mb;
 		std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = SceneTree.Root->SerializeChildren(mb);
 		std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins;
 		for (auto& [_, property] : CustomProperties)
@@ -1719,8 +1747,13 @@ void FMZSceneTreeManager::SendNodeUpdate(FGuid nodeId, bool bResetRootPins)
 		auto offset =  mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)(&nodeId), mz::ClearFlags::ANY & ~mz::ClearFlags::CLEAR_METADATA, 0, &graphPins, 0, &graphFunctions, 0, &graphNodes, 0, 0, &metadata);
 		mb.Finish(offset);
 		auto buf = mb.Release();
+		TOptional<uint64> stateHash;
+		if (!MZClient->OutboundDedup.ShouldSendDeferred(EMZOutboundKind::NodeUpdate, nodeId, buf.data(), buf.size(), stateHash))
+		{
+			return;
+		}
 		auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root, stateHash);
 
 		return;
 	}
@@ -1729,7 +1762,7 @@ void FMZSceneTreeManager::SendNodeUpdate(FGuid nodeId, bool bResetRootPins)
 	{
 		return;
 	}
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = treeNode->SerializeChildren(mb);
 	std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins;
 	if (treeNode->GetAsActorNode())
@@ -1752,8 +1785,13 @@ void FMZSceneTreeManager::SendNodeUpdate(FGuid nodeId, bool bResetRootPins)
 	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&nodeId, mz::ClearFlags::CLEAR_PINS | mz::ClearFlags::CLEAR_FUNCTIONS | mz::ClearFlags::CLEAR_NODES | mz::ClearFlags::CLEAR_METADATA, 0, &graphPins, 0, &graphFunctions, 0, &graphNodes, 0, 0, &metadata);
 	mb.Finish(offset);
 	auto buf = mb.Release();
+	TOptional<uint64> stateHash;
+	if (!MZClient->OutboundDedup.ShouldSendDeferred(EMZOutboundKind::NodeUpdate, nodeId, buf.data(), buf.size(), stateHash))
+	{
+		return;
+	}
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root, stateHash);
 }
 
 void FMZSceneTreeManager::SendEngineFunctionUpdate()
@@ -1762,7 +1800,7 @@ void FMZSceneTreeManager::SendEngineFunctionUpdate()
 	{
 		return;
 	}
-	flatbuffers::FlatBufferBuilder mb = flatbuffers::FlatBufferBuilder();
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Node>> graphFunctions;
 	for (auto& [_, cfunc] : CustomFunctions)
 	{
@@ -1774,7 +1812,7 @@ void FMZSceneTreeManager::SendEngineFunctionUpdate()
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 }
 
 void FMZSceneTreeManager::SendPinValueChanged(FGuid propertyId, std::vector<uint8> data)
@@ -1784,11 +1822,17 @@ void FMZSceneTreeManager::SendPinValueChanged(FGuid propertyId, std::vector<uint
 		return;
 	}
 
-	flatbuffers::FlatBufferBuilder mb;
+	if (!MZClient->OutboundDedup.ShouldSend(EMZOutboundKind::PinValue, propertyId, data.data(), data.size()))
+	{
+		return;
+	}
+
+	FMZFlatBufferBuilder mb;
 	auto offset = mz::CreatePinValueChangedDirect(mb, (mz::fb::UUID*)&propertyId, &data);
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PinValueChanged>(buf.data());
+	MZClient->NodeUpdates.Flush();
 	MZClient->AppServiceClient->NotifyPinValueChanged(*root);
 }
 
@@ -1801,7 +1845,7 @@ void FMZSceneTreeManager::SendPinUpdate()
 
 	auto nodeId = FMZClient::NodeId;
 
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins;
 	for (auto& [_, pin] : CustomProperties)
 	{
@@ -1815,7 +1859,7 @@ void FMZSceneTreeManager::SendPinUpdate()
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 }
 
@@ -1828,6 +1872,7 @@ void FMZSceneTreeManager::RemovePortal(FGuid PortalId)
 		return;
 	}
 	auto Portal = MZPropertyManager.PortalPinsById.FindRef(PortalId);
+	MZPropertyManager.UnregisterPortalQueue(Portal);
 	MZPropertyManager.PortalPinsById.Remove(Portal.Id);
 	MZPropertyManager.PropertyToPortalPin.Remove(Portal.SourceId);
 
@@ -1835,7 +1880,7 @@ void FMZSceneTreeManager::RemovePortal(FGuid PortalId)
 	{
 		return;
 	}
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<mz::fb::UUID> pinsToDelete;
 	pinsToDelete.push_back(*(mz::fb::UUID*)&Portal.Id);
 
@@ -1843,7 +1888,7 @@ void FMZSceneTreeManager::RemovePortal(FGuid PortalId)
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 }
 
 void FMZSceneTreeManager::SendPinAdded(FGuid NodeId, TSharedPtr<MZProperty> const& mzprop)
@@ -1852,17 +1897,48 @@ void FMZSceneTreeManager::SendPinAdded(FGuid NodeId, TSharedPtr<MZProperty> cons
 	{
 		return;
 	}
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins = { mzprop->Serialize(mb) };
 	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&NodeId, mz::ClearFlags::NONE, 0, &graphPins, 0, 0, 0, 0);
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 	return;
 }
 
+void FMZSceneTreeManager::SendRingHandlesChanged(MZProperty* MzProperty)
+{
+	if (!MZClient->IsConnected())
+	{
+		return;
+	}
+	//the handles are in the pin metadata, adding a pin with the same id again replaces it in MediaZ
+	FMZFlatBufferBuilder mb;
+	std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins;
+	if (FGuid* PortalId = MZPropertyManager.PropertyToPortalPin.Find(MzProperty->Id))
+	{
+		if (MZPortal* Portal = MZPropertyManager.PortalPinsById.Find(*PortalId))
+		{
+			graphPins.push_back(MZPropertyManager.SerializePortal(mb, *Portal, MzProperty));
+		}
+	}
+	if (Pins.Contains(MzProperty->Id) || CustomProperties.Contains(MzProperty->Id))
+	{
+		graphPins.push_back(MzProperty->Serialize(mb));
+	}
+	if (graphPins.empty())
+	{
+		return;
+	}
+	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::NONE, 0, &graphPins, 0, 0, 0, 0);
+	mb.Finish(offset);
+	auto buf = mb.Release();
+	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
+}
+
 void FMZSceneTreeManager::SendActorAddedOnUpdate(AActor* actor, FString spawnTag)
 {
 	if (AlwaysUpdateOnActorSpawns)
@@ -1898,13 +1974,13 @@ void FMZSceneTreeManager::SendActorAdded(AActor* actor, FString spawnTag)
 			{
 				return;
 			}
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = { newNode->Serialize(mb) };
 			auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&parentNode->Id, mz::ClearFlags::NONE, 0, 0, 0, 0, 0, &graphNodes);
 			mb.Finish(offset);
 			auto buf = mb.Release();
 			auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-			MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+			MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 		}
 	}
@@ -1925,13 +2001,13 @@ void FMZSceneTreeManager::SendActorAdded(AActor* actor, FString spawnTag)
 			return;
 		}
 
-		flatbuffers::FlatBufferBuilder mb;
+		FMZFlatBufferBuilder mb;
 		std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = { mostRecentParent->Serialize(mb) };
 		auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&mostRecentParent->Parent->Id, mz::ClearFlags::NONE, 0, 0, 0, 0, 0, &graphNodes);
 		mb.Finish(offset);
 		auto buf = mb.Release();
 		auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 	}
 
@@ -2028,6 +2104,7 @@ void FMZSceneTreeManager::SendActorDeleted(AActor* Actor)
 		}
 		for (auto PortalId : PortalsToRemove)
 		{
+			MZPropertyManager.UnregisterPortalQueue(MZPropertyManager.PortalPinsById.FindChecked(PortalId));
 			MZPropertyManager.PortalPinsById.Remove(PortalId);
 		}
 
@@ -2064,21 +2141,21 @@ void FMZSceneTreeManager::SendActorDeleted(AActor* Actor)
 			{
 				pinsToDelete.push_back(*(mz::fb::UUID*)&portalId);
 			}
-			flatbuffers::FlatBufferBuilder mb;
+			FMZFlatBufferBuilder mb;
 			auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::NONE, &pinsToDelete, 0, 0, 0, 0, 0);
 			mb.Finish(offset);
 			auto buf = mb.Release();
 			auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-			MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+			MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 		}
 
-		flatbuffers::FlatBufferBuilder mb2;
+		FMZFlatBufferBuilder mb2;
 		std::vector<mz::fb::UUID> graphNodes = { *(mz::fb::UUID*)&node->Id };
 		auto offset = mz::CreatePartialNodeUpdateDirect(mb2, (mz::fb::UUID*)&parentId, mz::ClearFlags::NONE, 0, 0, 0, 0, &graphNodes, 0);
 		mb2.Finish(offset);
 		auto buf = mb2.Release();
 		auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 	}
 }
 
@@ -2153,11 +2230,28 @@ void FMZSceneTreeManager::SendSyncSemaphores(bool RenewSemaphores)
 	uint64_t inputSemaphore = (uint64_t)TextureShareManager->SyncSemaphoresExportHandles.InputSemaphore;
 	uint64_t outputSemaphore = (uint64_t)TextureShareManager->SyncSemaphoresExportHandles.OutputSemaphore;
 
-	flatbuffers::FlatBufferBuilder mb;
+	//a pipelined MediaZ needs the depth and the fences it signals when it is done with a slot before the sync starts
+	if (TextureShareManager->GetPipelineDepth() > 1)
+	{
+		auto& RootMetaData = SceneTree.Root->mzMetaData;
+		RootMetaData.Add(MzMetadataKeys::TexturePipelineDepth, FString::FromInt(TextureShareManager->GetPipelineDepth()));
+		RootMetaData.Add(MzMetadataKeys::InputReleaseSemaphore, FString::Printf(TEXT("%llu"), (uint64_t)TextureShareManager->SyncSemaphoresExportHandles.InputReleaseSemaphore));
+		RootMetaData.Add(MzMetadataKeys::OutputReleaseSemaphore, FString::Printf(TEXT("%llu"), (uint64_t)TextureShareManager->SyncSemaphoresExportHandles.OutputReleaseSemaphore));
+
+		FMZFlatBufferBuilder fb;
+		std::vector<flatbuffers::Offset<mz::fb::MetaDataEntry>> metadata = SceneTree.Root->SerializeMetaData(fb);
+		auto metadataOffset = mz::CreatePartialNodeUpdateDirect(fb, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::NONE, 0, 0, 0, 0, 0, 0, 0, 0, &metadata);
+		fb.Finish(metadataOffset);
+		auto metadataBuf = fb.Release();
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*flatbuffers::GetRoot<mz::PartialNodeUpdate>(metadataBuf.data()));
+	}
+
+	FMZFlatBufferBuilder mb;
 	auto offset = mz::CreateAppEventOffset(mb, mz::app::CreateSetSyncSemaphores(mb, (mz::fb::UUID*)&FMZClient::NodeId, FPlatformProcess::GetCurrentProcessId(), inputSemaphore, outputSemaphore));
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::app::AppEvent>(buf.data());
+	MZClient->NodeUpdates.Flush();
 	MZClient->AppServiceClient->Send(*root);
 }
 
@@ -2179,7 +2273,7 @@ void FMZSceneTreeManager::HandleWorldChange()
 	TArray<TTuple<PortalSourceContainerInfo, MZPortal>> Portals;
 	TSet<FGuid> ActorsToRescan;
 
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<mz::fb::UUID> graphPins;// = { *(mz::fb::UUID*)&node->Id };
 	std::vector<flatbuffers::Offset<mz::PartialPinUpdate>> PinUpdates;
 
@@ -2232,7 +2326,7 @@ void FMZSceneTreeManager::HandleWorldChange()
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 	PinUpdates.clear();
 
 	MZPropertyManager.Reset(false);
@@ -2246,7 +2340,7 @@ void FMZSceneTreeManager::HandleWorldChange()
 		PopulateAllChildsOfActor(ActorId);
 	}
 
-	flatbuffers::FlatBufferBuilder mbb;
+	FMZFlatBufferBuilder mbb;
 	std::vector<mz::fb::UUID> PinsToRemove;
 	for (auto& [containerInfo, portal] : Portals)
 	{
@@ -2261,11 +2355,14 @@ void FMZSceneTreeManager::HandleWorldChange()
 			if (MZPropertyManager.PortalPinsById.Contains(portal.Id))
 			{
 				auto pPortal = MZPropertyManager.PortalPinsById.Find(portal.Id);
+				MZPropertyManager.UnregisterPortalQueue(*pPortal);
 				pPortal->SourceId = MzProperty->Id;
+				MZPropertyManager.RegisterPortalQueue(*pPortal, MzProperty.Get());
 			}
 			portal.SourceId = MzProperty->Id;
 			MzProperty->PinShowAs = portal.ShowAs;
 			MZTextureShareManager::GetInstance()->UpdatePinShowAs(MzProperty.Get(), MzProperty->PinShowAs);
+			MZClient->NodeUpdates.Flush();
 			MZClient->AppServiceClient->SendPinShowAsChange((mz::fb::UUID&)MzProperty->Id, MzProperty->PinShowAs);
 			MZPropertyManager.PropertyToPortalPin.Add(MzProperty->Id, portal.Id);
 			PinUpdates.push_back(mz::CreatePartialPinUpdate(mbb, (mz::fb::UUID*)&portal.Id, (mz::fb::UUID*)&MzProperty->Id, mz::fb::CreateOrphanStateDirect(mbb, notOrphan, notOrphan ? "" : "Object not found in the world")));
@@ -2283,16 +2380,16 @@ void FMZSceneTreeManager::HandleWorldChange()
 		mbb.Finish(offset1);
 		auto buf1 = mbb.Release();
 		auto root1 = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf1.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root1);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root1);
 	}
 	if(!PinsToRemove.empty())
 	{
-		flatbuffers::FlatBufferBuilder mb2;
+		FMZFlatBufferBuilder mb2;
 		auto offset2 = mz::CreatePartialNodeUpdateDirect(mb2, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::NONE, &PinsToRemove);
 		mb2.Finish(offset2);
 		auto buf2 = mb2.Release();
 		auto root2 = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf2.data());
-		MZClient->AppServiceClient->SendPartialNodeUpdate(*root2);
+		MZClient->NodeUpdates.SendPartialNodeUpdate(*root2);
 	}
 
 	LOG("World change handled");
@@ -2442,13 +2539,13 @@ AActor* FMZActorManager::SpawnActor(FString SpawnTag, MZSpawnActorParameters Par
 		return SpawnedActor;
 	}
 
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = { mostRecentParent->Serialize(mb) };
 	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&mostRecentParent->Parent->Id, mz::ClearFlags::NONE, 0, 0, 0, 0, 0, &graphNodes);
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 	return SpawnedActor;
 }
@@ -2494,13 +2591,13 @@ AActor* FMZActorManager::SpawnUMGRenderManager(FString umgTag, UUserWidget* widg
 		return UMGManager;
 	}
 
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Node>> graphNodes = { mostRecentParent->Serialize(mb) };
 	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&mostRecentParent->Parent->Id, mz::ClearFlags::NONE, 0, 0, 0, 0, 0, &graphNodes);
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 
 	return UMGManager;
 }
@@ -2636,6 +2733,7 @@ void FMZPropertyManager::CreatePortal(FGuid PropertyId, mz::fb::ShowAs ShowAs)
 		return;
 	}
 	MZTextureShareManager::GetInstance()->UpdatePinShowAs(MZProperty.Get(), ShowAs);
+	MZClient->NodeUpdates.Flush();
 	MZClient->AppServiceClient->SendPinShowAsChange((mz::fb::UUID&)MZProperty->Id, ShowAs);
 	
 	MZPortal NewPortal{StringToFGuid(MZProperty->Id.ToString()) ,PropertyId};
@@ -2659,6 +2757,7 @@ void FMZPropertyManager::CreatePortal(FGuid PropertyId, mz::fb::ShowAs ShowAs)
 	NewPortal.CategoryName = MZProperty->CategoryName;
 	NewPortal.ShowAs = ShowAs;
 
+	RegisterPortalQueue(NewPortal, MZProperty.Get());
 	PortalPinsById.Add(NewPortal.Id, NewPortal);
 	PropertyToPortalPin.Add(PropertyId, NewPortal.Id);
 
@@ -2666,13 +2765,13 @@ void FMZPropertyManager::CreatePortal(FGuid PropertyId, mz::fb::ShowAs ShowAs)
 	{
 		return;
 	}
-	flatbuffers::FlatBufferBuilder mb;
+	FMZFlatBufferBuilder mb;
 	std::vector<flatbuffers::Offset<mz::fb::Pin>> graphPins = { SerializePortal(mb, NewPortal, MZProperty.Get()) };
 	auto offset = mz::CreatePartialNodeUpdateDirect(mb, (mz::fb::UUID*)&FMZClient::NodeId, mz::ClearFlags::NONE, 0, &graphPins, 0, 0, 0, 0);
 	mb.Finish(offset);
 	auto buf = mb.Release();
 	auto root = flatbuffers::GetRoot<mz::PartialNodeUpdate>(buf.data());
-	MZClient->AppServiceClient->SendPartialNodeUpdate(*root);
+	MZClient->NodeUpdates.SendPartialNodeUpdate(*root);
 }
 
 void FMZPropertyManager::CreatePortal(FProperty* uproperty, UObject* Container, mz::fb::ShowAs ShowAs)
@@ -2689,6 +2788,38 @@ void FMZPropertyManager::CreatePortal(FProperty* uproperty, UObject* Container,
 	}
 }
 
+void FMZPropertyManager::RegisterPortalQueue(MZPortal& Portal, MZProperty* SourceProperty)
+{
+	if (!MZClient->EventDelegates || Portal.QueueHandle.IsValid())
+	{
+		return;
+	}
+	Portal.QueueHandle = MZClient->EventDelegates->RegisterPin(*((mz::fb::UUID*)&SourceProperty->Id), Portal.DisplayName, Portal.ShowAs == mz::fb::ShowAs::INPUT_PIN);
+}
+
+void FMZPropertyManager::UpdatePortalQueueOrdering(MZPortal const& Portal)
+{
+	if (!MZClient->EventDelegates)
+	{
+		return;
+	}
+	//input pins keep every value in order, property pins only need the latest one
+	MZClient->EventDelegates->SetPinFrameOrdered(Portal.QueueHandle, Portal.ShowAs == mz::fb::ShowAs::INPUT_PIN);
+}
+
+void FMZPropertyManager::UnregisterPortalQueue(MZPortal& Portal)
+{
+	if (!MZClient->EventDelegates)
+	{
+		return;
+	}
+	if (MZClient->EventDelegates->UnregisterPin(Portal.QueueHandle))
+	{
+		//the producer can give the pin's shared memory slot to another pin
+		MZClient->SharedPins.ReleasePin(Portal.SourceId);
+	}
+}
+
 TSharedPtr<MZProperty> FMZPropertyManager::CreateProperty(UObject* container, FProperty* uproperty, FString parentCategory)
 {
 	TSharedPtr<MZProperty> MzProperty = MZPropertyFactory::CreateProperty(container, uproperty, parentCategory);
@@ -2768,6 +2899,10 @@ void FMZPropertyManager::Reset(bool ResetPortals)
 {
 	if (ResetPortals)
 	{
+		for (auto& [id, portal] : PortalPinsById)
+		{
+			UnregisterPortalQueue(portal);
+		}
 		PropertyToPortalPin.Empty();
 		PortalPinsById.Empty();
 	}
@@ -2779,7 +2914,11 @@ void FMZPropertyManager::Reset(bool ResetPortals)
 
 void FMZPropertyManager::OnBeginFrame()
 {
-	for (auto [id, portal] : PortalPinsById)
+	//one deadline for the whole frame so several late pins do not add up their waits
+	double WaitDeadline = FPlatformTime::Seconds() + FApp::GetDeltaTime() * FMath::Clamp(CVarPinWaitBudget.GetValueOnGameThread(), 0.f, 1.f);
+	TArray<uint8> SharedValue;
+
+	for (auto& [id, portal] : PortalPinsById)
 	{
 		if (portal.ShowAs == mz::fb::ShowAs::OUTPUT_PIN || 
 		    !PropertiesById.Contains(portal.SourceId))
@@ -2795,11 +2934,39 @@ void FMZPropertyManager::OnBeginFrame()
 			continue;
 		}
 
+		//portals created before the client was up have no queue yet
+		RegisterPortalQueue(portal, MzProperty.Get());
+
 		auto shouldWait = portal.ShowAs == mz::fb::ShowAs::INPUT_PIN && portal.TypeName == "mz.fb.Track";
-		auto buffer = MZClient->EventDelegates->Pop(*((mz::fb::UUID*)&MzProperty->Id), shouldWait, MZTextureShareManager::GetInstance()->FrameCounter);
-		if (!buffer.IsEmpty())
+		auto FrameCounter = MZTextureShareManager::GetInstance()->FrameCounter;
+
+		//values written to shared memory take precedence, gRPC stays the fallback.
+		//Track pins only take the sample of this very frame, otherwise they go through the jitter buffer and prediction below.
+		uint32 SharedFrameNumber = 0;
+		if (MZClient->SharedPins.Read(portal.SourceId, FrameCounter, shouldWait, SharedValue, SharedFrameNumber)
+			&& (!shouldWait || SharedFrameNumber == FrameCounter))
+		{
+			MzProperty->SetPropValue(SharedValue.GetData(), SharedValue.Num());
+			if (shouldWait)
+			{
+				static_cast<MZTrackProperty*>(MzProperty.Get())->RecordSample(SharedFrameNumber);
+			}
+			continue;
+		}
+
+		auto sample = shouldWait ? MZClient->EventDelegates->PopBuffered(portal.QueueHandle, FrameCounter, WaitDeadline)
+								 : MZClient->EventDelegates->Pop(portal.QueueHandle, false, FrameCounter);
+		if (sample && !sample->Payload.IsEmpty())
+		{
+			MzProperty->SetPropValue((void*)sample->Payload.Data(), sample->Payload.Size());
+			if (shouldWait)
+			{
+				static_cast<MZTrackProperty*>(MzProperty.Get())->RecordSample(sample->FrameNumber);
+			}
+		}
+		else if (shouldWait)
 		{
-			MzProperty->SetPropValue(buffer.data(), buffer.size());
+			static_cast<MZTrackProperty*>(MzProperty.Get())->PredictMissingSample();
 		}
 	}
 }
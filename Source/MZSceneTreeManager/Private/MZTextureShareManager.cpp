@@ -30,6 +30,8 @@
 
 MZTextureShareManager* MZTextureShareManager::singleton;
 
+static TAutoConsoleVariable<int32> CVarTexturePipelineDepth(TEXT("mediaz.TexturePipelineDepth"), 1, TEXT("Shared textures per texture pin and frames UE may render ahead of MediaZ, 1 to 3. 1 keeps UE and MediaZ in lock step, above 1 needs a MediaZ that reads the TexturePipelineDepth metadata. Read at startup."));
+
 //#define FAIL_SAFE_THREAD
 //#define DEBUG_FRAME_SYNC_LOG
 
@@ -140,6 +142,7 @@ mz::fb::TTexture MZTextureShareManager::AddTexturePin(MZProperty* mzprop)
 	{
 		//start property pins as output pins
 		Copies.Add(mzprop, copyInfo);
+		CopyPlansDirty = true;
 	}
 	return texture;
 }
@@ -156,34 +159,38 @@ bool MZTextureShareManager::CreateTextureResource(MZProperty* mzprop, mz::fb::TT
 		mzprop->OrphanMessage = "No texture resource bound to property!";
 		return false;
 	}
-	
-	UTextureRenderTarget2D* NewRenderTarget2D = NewObject<UTextureRenderTarget2D>(GetTransientPackage(), *(mzprop->DisplayName +FGuid::NewGuid().ToString()), RF_MarkAsRootSet);
-	check(NewRenderTarget2D);
-	NewRenderTarget2D->Rename(*(mzprop->DisplayName +FGuid::NewGuid().ToString()));
-	NewRenderTarget2D->RenderTargetFormat = trt2d->RenderTargetFormat;
-	NewRenderTarget2D->ClearColor = trt2d->ClearColor;
-	NewRenderTarget2D->bAutoGenerateMips = 0;
-	NewRenderTarget2D->bCanCreateUAV = true;
-	NewRenderTarget2D->bGPUSharedFlag = true;
-	NewRenderTarget2D->InitAutoFormat(info.Width, info.Height);	
-	NewRenderTarget2D->UpdateResourceImmediate(true);
-	FlushRenderingCommands();
-	
-	auto rt = NewRenderTarget2D->GameThread_GetRenderTargetResource();
-	//if (!rt) return false;
-	auto RHIResource = rt->GetTexture2DRHI();
-	if (!RHIResource || !RHIResource->IsValid())
+
+	FMZRenderTargetPool::FKey Key = { info.Width, info.Height, trt2d->RenderTargetFormat, (uint32)info.Usage };
+	HANDLE handle;
+	UTextureRenderTarget2D* NewRenderTarget2D = RenderTargetPool.Acquire(Key, trt2d->ClearColor, mzprop->DisplayName, handle);
+	if (!NewRenderTarget2D)
 	{
 		return false;
 	}
-	FRHITexture* RHITexture = RHIResource;
-	FD3D12Texture* Result((FD3D12Texture*)RHITexture->GetTextureBaseRHI());
-	
-	ID3D12Resource* DXResource = Result->GetResource()->GetResource();
-    DXResource->SetName(*mzprop->DisplayName);
-	
-    HANDLE handle;
-    MZ_D3D12_ASSERT_SUCCESS(Dev->CreateSharedHandle(DXResource, 0, GENERIC_ALL, 0, &handle));
+
+	//the other slots of the ring are published in the pin metadata, MediaZ picks the slot of a frame with frame % depth
+	TArray<TObjectPtr<UTextureRenderTarget2D>> RingResources;
+	FString RingHandles;
+	for (uint32 Slot = 1; Slot < GetPipelineDepth(); ++Slot)
+	{
+		HANDLE SlotHandle;
+		UTextureRenderTarget2D* SlotResource = RenderTargetPool.Acquire(Key, trt2d->ClearColor, mzprop->DisplayName, SlotHandle);
+		if (!SlotResource)
+		{
+			RenderTargetPool.Release(NewRenderTarget2D);
+			for (auto& Acquired : RingResources)
+			{
+				RenderTargetPool.Release(Acquired);
+			}
+			return false;
+		}
+		RingResources.Add(SlotResource);
+		RingHandles += FString::Printf(TEXT("%s%llu"), RingHandles.IsEmpty() ? TEXT("") : TEXT(","), (u64)SlotHandle);
+	}
+	if (GetPipelineDepth() > 1)
+	{
+		mzprop->mzMetaDataMap.Add(MzMetadataKeys::TextureRingHandles, RingHandles);
+	}
 	
 	Texture.size = mz::fb::SizePreset::CUSTOM;
 	Texture.width = info.Width;
@@ -201,10 +208,21 @@ bool MZTextureShareManager::CreateTextureResource(MZProperty* mzprop, mz::fb::TT
 
 	Resource.SrcMzp = mzprop;
 	Resource.DstResource = NewRenderTarget2D;
+	Resource.RingResources = MoveTemp(RingResources);
 	Resource.ShowAs = mzprop->PinShowAs;
 	return true;
 }
 
+void MZTextureShareManager::ReleaseTextureResource(ResourceInfo& Resource)
+{
+	RenderTargetPool.Release(Resource.DstResource);
+	for (auto& SlotResource : Resource.RingResources)
+	{
+		RenderTargetPool.Release(SlotResource);
+	}
+	Resource.DstResource = nullptr;
+	Resource.RingResources.Reset();
+}
 
 void MZTextureShareManager::UpdateTexturePin(MZProperty* mzprop, mz::fb::ShowAs RealShowAs)
 {
@@ -227,14 +245,16 @@ bool MZTextureShareManager::UpdateTexturePin(MZProperty* MzProperty, mz::fb::TTe
 	mz::fb::Format fmt = mz::fb::Format(info.Format);
 	mz::fb::ImageUsage usage = mz::fb::ImageUsage(info.Usage) | mz::fb::ImageUsage::SAMPLED;
 
-	if (Texture.width != info.Width ||
+	if (!resourceInfo->DstResource ||
+		Texture.width != info.Width ||
 		Texture.height != info.Height ||
 		Texture.format != fmt ||
 		Texture.usage != usage)
 	{
 		changed = true;
 		
-		ResourcesToDelete.Enqueue({resourceInfo->DstResource, GFrameCounter});
+		ReleaseTextureResource(*resourceInfo);
+		CopyPlansDirty = true;
 		mz::fb::ShowAs tmp = resourceInfo->ShowAs;
 		if(!CreateTextureResource(MzProperty, Texture, *resourceInfo))
 		{
@@ -243,6 +263,7 @@ bool MZTextureShareManager::UpdateTexturePin(MZProperty* MzProperty, mz::fb::TTe
 		
 		resourceInfo->ShowAs = tmp;
 		Copies[MzProperty] = *resourceInfo;
+		CopyPlansDirty = true;
 	}
 
 	return changed;
@@ -253,15 +274,22 @@ void MZTextureShareManager::UpdatePinShowAs(MZProperty* MzProperty, mz::fb::Show
 	if(Copies.Contains(MzProperty))
 	{
 		auto resourceInfo = Copies.Find(MzProperty);
-		resourceInfo->ShowAs = NewShowAs;
+		if (resourceInfo->ShowAs != NewShowAs)
+		{
+			resourceInfo->ShowAs = NewShowAs;
+			CopyPlansDirty = true;
+		}
 	}
 }
 
 void MZTextureShareManager::TextureDestroyed(MZProperty* textureProp)
 {
+	if (auto resourceInfo = Copies.Find(textureProp))
+	{
+		ReleaseTextureResource(*resourceInfo);
+	}
 	Copies.Remove(textureProp);
-	
-	//TODO delete real resource	
+	CopyPlansDirty = true;
 }
 
 static HANDLE DupeHandle(uint64_t pid, HANDLE handle)
@@ -288,10 +316,43 @@ static bool ImportSharedFence(uint64_t pid, HANDLE handle, ID3D12Device* pDevice
        return true;
 }
 
-void FilterCopies(mz::fb::ShowAs FilterShowAs, TMap<MZProperty*, ResourceInfo>& Copies, TMap<UTextureRenderTarget2D*, ResourceInfo>& FilteredCopies)
+void MZTextureShareManager::UpdateCopyPlans()
 {
-	for (auto [mzprop, info] : Copies)
+	if (CopyPlansDirty || !AreCopyPlansValid())
 	{
+		RebuildCopyPlans();
+	}
+}
+
+bool MZTextureShareManager::AreCopyPlansValid() const
+{
+	for (auto const& Source : CopyPlanSources)
+	{
+		UObject* obj = Source.Property->GetRawObjectContainer();
+		auto prop = CastField<FObjectProperty>(Source.Property->Property);
+		UObject* Target = obj && prop ? prop->GetObjectPropertyValue(prop->ContainerPtrToValuePtr<UObject>(obj)) : nullptr;
+		if (Target != Source.Target)
+		{
+			return false;
+		}
+		if (Source.Target && (Source.Target->GameThread_GetRenderTargetResource() != Source.Resource ||
+			Source.Target->SizeX != Source.SizeX || Source.Target->SizeY != Source.SizeY || Source.Target->RenderTargetFormat != Source.Format))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void MZTextureShareManager::RebuildCopyPlans()
+{
+	CopyPlanSources.Reset();
+	auto InputPlan = MakeShared<FMZCopyPlan, ESPMode::ThreadSafe>();
+	auto OutputPlan = MakeShared<FMZCopyPlan, ESPMode::ThreadSafe>();
+
+	for (auto& [mzprop, info] : Copies)
+	{
+		FCopyPlanSource& Source = CopyPlanSources.Add_GetRef({ mzprop });
 		UObject* obj = mzprop->GetRawObjectContainer();
 		if (!obj) continue;
 		auto prop = CastField<FObjectProperty>(mzprop->Property);
@@ -299,43 +360,70 @@ void FilterCopies(mz::fb::ShowAs FilterShowAs, TMap<MZProperty*, ResourceInfo>&
 		auto URT = Cast<UTextureRenderTarget2D>(prop->GetObjectPropertyValue(prop->ContainerPtrToValuePtr<UTextureRenderTarget2D>(obj)));
 		if (!URT) continue;
 		
-		 if(info.DstResource->SizeX != URT->SizeX || info.DstResource->SizeY != URT->SizeY)
-		 {
-		 	//todo texture is changed update it
-		 	
+		if(!info.DstResource || info.DstResource->SizeX != URT->SizeX || info.DstResource->SizeY != URT->SizeY || info.DstResource->RenderTargetFormat != URT->RenderTargetFormat)
+		{
 			const mz::fb::Texture* tex = flatbuffers::GetRoot<mz::fb::Texture>(mzprop->data.data());
 			mz::fb::TTexture texture;
 			tex->UnPackTo(&texture);
 
-		 	auto TextureShareManager = MZTextureShareManager::GetInstance();
-			if (TextureShareManager->UpdateTexturePin(mzprop, texture))
+			if (UpdateTexturePin(mzprop, texture))
 			{
-				// data = mz::Buffer::From(texture);
-				flatbuffers::FlatBufferBuilder fb;
+				FMZFlatBufferBuilder fb;
 				auto offset = mz::fb::CreateTexture(fb, &texture);
 				fb.Finish(offset);
 				mz::Buffer buffer = fb.Release();
 				mzprop->data = buffer;
 				
-				if (!TextureShareManager->MZClient->IsConnected() || mzprop->data.empty())
+				//a recreated ring has new handles in the pin metadata, MediaZ has to get them before the new value
+				if (GetPipelineDepth() > 1 && OnRingHandlesChanged)
 				{
-					return;
+					OnRingHandlesChanged(mzprop);
+				}
+				if (MZClient->IsConnected() && !mzprop->data.empty())
+				{
+					FMZFlatBufferBuilder mb;
+					auto offset2 = mz::CreatePinValueChangedDirect(mb, (mz::fb::UUID*)&mzprop->Id, &mzprop->data);
+					mb.Finish(offset2);
+					auto buf = mb.Release();
+					auto root = flatbuffers::GetRoot<mz::PinValueChanged>(buf.data());
+					MZClient->NodeUpdates.Flush();
+					MZClient->AppServiceClient->NotifyPinValueChanged(*root);
 				}
-				
-				flatbuffers::FlatBufferBuilder mb;
-				auto offset2 = mz::CreatePinValueChangedDirect(mb, (mz::fb::UUID*)&mzprop->Id, &mzprop->data);
-				mb.Finish(offset2);
-				auto buf = mb.Release();
-				auto root = flatbuffers::GetRoot<mz::PinValueChanged>(buf.data());
-				TextureShareManager->MZClient->AppServiceClient->NotifyPinValueChanged(*root);
 			}
-		 }
-			
-		if(info.ShowAs == FilterShowAs)
+		}
+
+		Source.Target = URT;
+		Source.Resource = URT->GameThread_GetRenderTargetResource();
+		Source.SizeX = URT->SizeX;
+		Source.SizeY = URT->SizeY;
+		Source.Format = URT->RenderTargetFormat;
+		//a pin whose shared textures could not be recreated is retried when its render target changes
+		if (!Source.Resource || !info.DstResource)
+		{
+			continue;
+		}
+
+		FMZCopyPlan::FCopy Copy;
+		Copy.Target = Source.Resource;
+		Copy.Size = FIntVector(info.DstResource->SizeX, info.DstResource->SizeY, 1);
+		for (uint32 Slot = 0; Slot < GetPipelineDepth(); ++Slot)
+		{
+			Copy.Slots.Add(info.GetSlotResource(Slot)->GameThread_GetRenderTargetResource());
+		}
+		if (info.ShowAs == mz::fb::ShowAs::INPUT_PIN)
+		{
+			InputPlan->Copies.Add(MoveTemp(Copy));
+		}
+		else if (info.ShowAs == mz::fb::ShowAs::OUTPUT_PIN)
 		{
-			FilteredCopies.Add(URT, info);
+			OutputPlan->Copies.Add(MoveTemp(Copy));
 		}
 	}
+
+	InputCopyPlan = InputPlan;
+	OutputCopyPlan = OutputPlan;
+	//recreated shared textures above already went into these plans
+	CopyPlansDirty = false;
 }
 
 void MZTextureShareManager::SetupFences(FRHICommandListImmediate& RHICmdList, mz::fb::ShowAs CopyShowAs,
@@ -343,49 +431,39 @@ void MZTextureShareManager::SetupFences(FRHICommandListImmediate& RHICmdList, mz
 {
 	if(ExecutionState == mz::app::ExecutionState::SYNCED)
 	{
-		if(CopyShowAs == mz::fb::ShowAs::INPUT_PIN)
+		if (CopyShowAs != mz::fb::ShowAs::INPUT_PIN && CopyShowAs != mz::fb::ShowAs::OUTPUT_PIN)
 		{
-			RHICmdList.EnqueueLambda([CmdQueue = CmdQueue,InputFence = InputFence, frameNumber](FRHICommandList& ExecutingCmdList)
-			{
-				GetID3D12DynamicRHI()->RHIWaitManualFence(ExecutingCmdList, InputFence, (2 * frameNumber) + 1);
-			});
-			SignalGroup.Add(InputFence, (2 * frameNumber) + 2);
-
-#ifdef DEBUG_FRAME_SYNC_LOG
-			UE_LOG(LogTemp, Warning, TEXT("Input pins are waiting on %d") , 2 * frameNumber + 1);
-#endif
-			
+			return;
 		}
-		else if (CopyShowAs == mz::fb::ShowAs::OUTPUT_PIN)
+		EMZCopyDirection Direction = CopyShowAs == mz::fb::ShowAs::INPUT_PIN ? EMZCopyDirection::Input : EMZCopyDirection::Output;
+		FMZFenceOp Wait = FenceSchedule->GetLocalWait(Direction, frameNumber);
+		FMZFenceOp Signal = FenceSchedule->GetLocalSignal(Direction, frameNumber);
+		RHICmdList.EnqueueLambda([WaitFence = GetFence(Wait.Fence), WaitValue = Wait.Value](FRHICommandList& ExecutingCmdList)
 		{
-			RHICmdList.EnqueueLambda([CmdQueue = CmdQueue, OutputFence = OutputFence, frameNumber = frameNumber](FRHICommandList& ExecutingCmdList)
-			{
-				
-				GetID3D12DynamicRHI()->RHIWaitManualFence(ExecutingCmdList, OutputFence, (2 * frameNumber));
-			});
-			SignalGroup.Add(OutputFence, (2 * frameNumber) + 1);
+			GetID3D12DynamicRHI()->RHIWaitManualFence(ExecutingCmdList, WaitFence, WaitValue);
+		});
+		SignalGroup.Add(GetFence(Signal.Fence), Signal.Value);
 
 #ifdef DEBUG_FRAME_SYNC_LOG
-			UE_LOG(LogTemp, Warning, TEXT("Out pins are waiting on %d") , 2 * frameNumber);
+		UE_LOG(LogTemp, Warning, TEXT("%s pins are waiting on %llu") , Direction == EMZCopyDirection::Input ? TEXT("Input") : TEXT("Out"), Wait.Value);
 #endif
-		}
 	}
 }
 
-void MZTextureShareManager::ProcessCopies(mz::fb::ShowAs CopyShowAs, TMap<MZProperty*, ResourceInfo>& CopyMap)
+void MZTextureShareManager::ProcessCopies(mz::fb::ShowAs CopyShowAs)
 {
 	{
-		if (CopyMap.IsEmpty())
+		if (Copies.IsEmpty())
 		{
 			return;
 		}
 	}
-	TMap<UTextureRenderTarget2D*, ResourceInfo> CopiesFiltered;
-	FilterCopies(CopyShowAs, CopyMap, CopiesFiltered);
+	UpdateCopyPlans();
 
-	//auto cmdData = GetNewCommandList();
+	//the render thread only reads the plan, a rebuild swaps in a new one
+	TSharedPtr<FMZCopyPlan const, ESPMode::ThreadSafe> Plan = CopyShowAs == mz::fb::ShowAs::INPUT_PIN ? InputCopyPlan : OutputCopyPlan;
 	ENQUEUE_RENDER_COMMAND(FMZClient_CopyOnTick)(
-		[this, CopyShowAs, CopiesFiltered, frameNumber = FrameCounter](FRHICommandListImmediate& RHICmdList)
+		[this, CopyShowAs, Plan, frameNumber = FrameCounter](FRHICommandListImmediate& RHICmdList)
 		{
 			if (CopyShowAs == mz::fb::ShowAs::OUTPUT_PIN)
 			{
@@ -399,12 +477,14 @@ void MZTextureShareManager::ProcessCopies(mz::fb::ShowAs CopyShowAs, TMap<MZProp
 			}
 			TMap<ID3D12Fence*, u64> SignalGroup;
 			SetupFences(RHICmdList, CopyShowAs, SignalGroup, frameNumber);
-			for (auto& [URT, pin] : CopiesFiltered)
+			//outside of synced execution MediaZ does not follow the frames and only looks at the first slot
+			uint32 Slot = ExecutionState == mz::app::ExecutionState::SYNCED ? FenceSchedule->GetSlot(frameNumber) : 0;
+			for (auto const& Copy : Plan->Copies)
 			{
 				FRHICopyTextureInfo CopyInfo;
-				CopyInfo.Size = FIntVector(pin.DstResource->SizeX, pin.DstResource->SizeY, 1);
-				FRHITexture* dst = pin.DstResource->GetRenderTargetResource()->GetRenderTargetTexture();
-				FRHITexture* src = URT->GetRenderTargetResource()->GetRenderTargetTexture();
+				CopyInfo.Size = Copy.Size;
+				FRHITexture* dst = Copy.Slots[Slot]->GetRenderTargetTexture();
+				FRHITexture* src = Copy.Target->GetRenderTargetTexture();
 				if(CopyShowAs == mz::fb::ShowAs::INPUT_PIN)
 				{
 					Swap(dst, src);
@@ -424,29 +504,14 @@ void MZTextureShareManager::ProcessCopies(mz::fb::ShowAs CopyShowAs, TMap<MZProp
 
 void MZTextureShareManager::OnBeginFrame()
 {
-	ProcessCopies(mz::fb::ShowAs::INPUT_PIN, Copies);
+	ProcessCopies(mz::fb::ShowAs::INPUT_PIN);
 }
 
 void MZTextureShareManager::OnEndFrame()
 {
-	ProcessCopies(mz::fb::ShowAs::OUTPUT_PIN, Copies);
+	ProcessCopies(mz::fb::ShowAs::OUTPUT_PIN);
 	FrameCounter++;
-	while(!ResourcesToDelete.IsEmpty())
-	{
-		TPair<TObjectPtr<UTextureRenderTarget2D>, uint32_t> resource;
-		ResourcesToDelete.Peek(resource);
-		if(resource.Value + 5 <= GFrameCounter) // resources are deleted after 5 frames, because we need to make sure that they are no longer in use
-		{
-			FlushRenderingCommands();
-			resource.Key->ReleaseResource();
-			resource.Key = nullptr;
-			ResourcesToDelete.Pop();
-		}
-		else
-		{
-			break;
-		}
-	}
+	RenderTargetPool.Tick();
 	// ENQUEUE_RENDER_COMMAND(FMZClient_CopyOnTick)(
 	// 	[this, FrameCount = GFrameCounter](FRHICommandListImmediate& RHICmdList)
 	// 	{
@@ -472,11 +537,7 @@ void MZTextureShareManager::SwitchStateToIdle_GRPCThread(u64 LastFrameNumber)
 	ExecutionState = mz::app::ExecutionState::IDLE;
 	for(int i = 0; i < 2; i++)
 	{
-		if (InputFence && OutputFence)
-		{
-			InputFence->Signal(UINT64_MAX);
-			OutputFence->Signal(UINT64_MAX);
-		}
+		SignalAllFences(UINT64_MAX);
 		FPlatformProcess::Sleep(0.2);
 	}
 	FrameCounter = 0;
@@ -484,12 +545,24 @@ void MZTextureShareManager::SwitchStateToIdle_GRPCThread(u64 LastFrameNumber)
 
 void MZTextureShareManager::Reset()
 {
+	for (auto& [mzprop, resourceInfo] : Copies)
+	{
+		ReleaseTextureResource(resourceInfo);
+	}
 	Copies.Empty();
 	PendingCopyQueue.Empty();
+	CopyPlansDirty = true;
 }
 
 void MZTextureShareManager::Initiate()
 {
+	uint32 PipelineDepth = FMath::Clamp(CVarTexturePipelineDepth.GetValueOnGameThread(), 1, 3);
+	FenceSchedule = MakeFenceSchedule(PipelineDepth);
+	if (PipelineDepth > 1)
+	{
+		UE_LOG(LogTemp, Display, TEXT("MediaZ texture pins use a pipeline depth of %u"), PipelineDepth);
+	}
+	
 	auto hwinfo = FHardwareInfo::GetHardwareInfo(NAME_RHI);
 	if ("D3D12" != hwinfo)
 	{
@@ -502,7 +575,8 @@ void MZTextureShareManager::Initiate()
 	Dev = (ID3D12Device*)GetID3D12DynamicRHI()->RHIGetNativeDevice();
 	CmdQueue = GetID3D12DynamicRHI()->RHIGetCommandQueue();
 	CmdQueue->AddRef();
-	
+	RenderTargetPool.Initialize(Dev, this);
+
 	
 #ifdef FAIL_SAFE_THREAD 
 			FailSafeRunnable = new MZGPUFailSafeRunnable(CmdQueue, Dev);
@@ -523,27 +597,62 @@ void MZTextureShareManager::Initiate()
 
 void MZTextureShareManager::RenewSemaphores()
 {
-	if (InputFence)
-	{
-		::CloseHandle(SyncSemaphoresExportHandles.InputSemaphore);
-		InputFence->Release();
-		InputFence = nullptr;
-
-	}
-	if (OutputFence)
-	{
-		::CloseHandle(SyncSemaphoresExportHandles.OutputSemaphore);
-		OutputFence->Release();
-		OutputFence = nullptr;
-	}
+	ReleaseFence(InputFence, SyncSemaphoresExportHandles.InputSemaphore);
+	ReleaseFence(OutputFence, SyncSemaphoresExportHandles.OutputSemaphore);
+	ReleaseFence(InputReleaseFence, SyncSemaphoresExportHandles.InputReleaseSemaphore);
+	ReleaseFence(OutputReleaseFence, SyncSemaphoresExportHandles.OutputReleaseSemaphore);
 
 	FrameCounter = 0;
+	RenderTargetPool.ResetConfirmFrames();
 	
 	Dev->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&InputFence));
 	Dev->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&OutputFence));
 	MZ_D3D12_ASSERT_SUCCESS(Dev->CreateSharedHandle(InputFence, 0, GENERIC_ALL, 0, &SyncSemaphoresExportHandles.InputSemaphore));
 	MZ_D3D12_ASSERT_SUCCESS(Dev->CreateSharedHandle(OutputFence, 0, GENERIC_ALL, 0, &SyncSemaphoresExportHandles.OutputSemaphore));
+
+	if (GetPipelineDepth() > 1)
+	{
+		Dev->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&InputReleaseFence));
+		Dev->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&OutputReleaseFence));
+		MZ_D3D12_ASSERT_SUCCESS(Dev->CreateSharedHandle(InputReleaseFence, 0, GENERIC_ALL, 0, &SyncSemaphoresExportHandles.InputReleaseSemaphore));
+		MZ_D3D12_ASSERT_SUCCESS(Dev->CreateSharedHandle(OutputReleaseFence, 0, GENERIC_ALL, 0, &SyncSemaphoresExportHandles.OutputReleaseSemaphore));
+	}
 }
 
-	
-	
+void MZTextureShareManager::ReleaseFence(ID3D12Fence*& Fence, HANDLE& Handle)
+{
+	if (Fence)
+	{
+		::CloseHandle(Handle);
+		Handle = 0;
+		Fence->Release();
+		Fence = nullptr;
+	}
+}
+
+ID3D12Fence* MZTextureShareManager::GetFence(EMZSyncFence Fence) const
+{
+	switch (Fence)
+	{
+	case EMZSyncFence::Input:
+		return InputFence;
+	case EMZSyncFence::Output:
+		return OutputFence;
+	case EMZSyncFence::InputRelease:
+		return InputReleaseFence;
+	case EMZSyncFence::OutputRelease:
+		return OutputReleaseFence;
+	}
+	return nullptr;
+}
+
+void MZTextureShareManager::SignalAllFences(uint64_t Value)
+{
+	for (ID3D12Fence* Fence : { InputFence, OutputFence, InputReleaseFence, OutputReleaseFence })
+	{
+		if (Fence)
+		{
+			Fence->Signal(Value);
+		}
+	}
+}
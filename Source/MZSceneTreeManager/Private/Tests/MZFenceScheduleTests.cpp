@@ -0,0 +1,117 @@
+// Copyright MediaZ AS. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MZFenceSchedule.h"
+#include <random>
+#include <vector>
+
+// Drives the fence schedules with simulated fences, a writer and a reader step in random order and only
+// proceed once the fence value they wait for has been signaled, like the GPU queues of UE and MediaZ.
+
+namespace
+{
+	struct FSimulationResult
+	{
+		uint32 Overwritten = 0;
+		uint32 ReadBeforeWritten = 0;
+		uint32 FenceWentBack = 0;
+		uint32 Deadlocks = 0;
+		uint64 MaxFramesAhead = 0;
+	};
+
+	FSimulationResult SimulateFences(IMZFenceSchedule const& Schedule, EMZCopyDirection Direction, uint64 Frames, uint32 Seed)
+	{
+		constexpr int64 Empty = -1;
+		FSimulationResult Result;
+		uint64 Fences[4] = {};
+		//frame whose texture a slot holds until the reader is done with it
+		std::vector<int64> Slots(Schedule.GetDepth(), Empty);
+		uint64 Written = 0;
+		uint64 Read = 0;
+		std::mt19937 Random(Seed);
+
+		auto IsSignaled = [&Fences](FMZFenceOp Op) { return Fences[uint8(Op.Fence)] >= Op.Value; };
+		auto Signal = [&Fences, &Result](FMZFenceOp Op)
+			{
+				uint64& Value = Fences[uint8(Op.Fence)];
+				Result.FenceWentBack += Op.Value <= Value;
+				Value = Op.Value;
+			};
+
+		while (Read < Frames)
+		{
+			bool bWriterReady = Written < Frames && IsSignaled(Schedule.GetWriterWait(Direction, Written));
+			bool bReaderReady = Read < Written && IsSignaled(Schedule.GetReaderWait(Direction, Read));
+			if (!bWriterReady && !bReaderReady)
+			{
+				Result.Deadlocks++;
+				break;
+			}
+			if (bWriterReady && (!bReaderReady || Random() % 2))
+			{
+				int64& Slot = Slots[Schedule.GetSlot(Written)];
+				Result.Overwritten += Slot != Empty;
+				Slot = int64(Written);
+				Signal(Schedule.GetWriterSignal(Direction, Written));
+				Written++;
+				Result.MaxFramesAhead = FMath::Max(Result.MaxFramesAhead, Written - Read);
+			}
+			else
+			{
+				int64& Slot = Slots[Schedule.GetSlot(Read)];
+				Result.ReadBeforeWritten += Slot != int64(Read);
+				Slot = Empty;
+				Signal(Schedule.GetReaderSignal(Direction, Read));
+				Read++;
+			}
+		}
+		return Result;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMZFenceScheduleTest, "MediaZ.SceneTree.FenceSchedule", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMZFenceScheduleTest::RunTest(const FString& Parameters)
+{
+	constexpr uint64 Frames = 10000;
+
+	for (uint32 Depth = 1; Depth <= 4; ++Depth)
+	{
+		std::unique_ptr<IMZFenceSchedule> Schedule = MakeFenceSchedule(Depth);
+		TestEqual(FString::Printf(TEXT("Depth %u: schedule depth"), Depth), Schedule->GetDepth(), Depth);
+
+		for (EMZCopyDirection Direction : { EMZCopyDirection::Input, EMZCopyDirection::Output })
+		{
+			FString Name = FString::Printf(TEXT("Depth %u %s"), Depth, Direction == EMZCopyDirection::Input ? TEXT("input") : TEXT("output"));
+
+			//UE reads the input pins and writes the output pins, MediaZ the opposite
+			TestTrue(Name + TEXT(": local side"), Direction == EMZCopyDirection::Output
+				? Schedule->GetLocalWait(Direction, 5).Value == Schedule->GetWriterWait(Direction, 5).Value && Schedule->GetLocalSignal(Direction, 5).Value == Schedule->GetWriterSignal(Direction, 5).Value
+				: Schedule->GetLocalWait(Direction, 5).Value == Schedule->GetReaderWait(Direction, 5).Value && Schedule->GetLocalSignal(Direction, 5).Value == Schedule->GetReaderSignal(Direction, 5).Value);
+			TestTrue(Name + TEXT(": remote side"), Direction == EMZCopyDirection::Output
+				? Schedule->GetRemoteSignal(Direction, 5).Value == Schedule->GetReaderSignal(Direction, 5).Value
+				: Schedule->GetRemoteSignal(Direction, 5).Value == Schedule->GetWriterSignal(Direction, 5).Value);
+
+			uint64 MaxFramesAhead = 0;
+			for (uint32 Seed = 1; Seed <= 8; ++Seed)
+			{
+				FSimulationResult Result = SimulateFences(*Schedule, Direction, Frames, Seed);
+				TestEqual(Name + TEXT(": slots overwritten before they were read"), Result.Overwritten, 0u);
+				TestEqual(Name + TEXT(": slots read before they were written"), Result.ReadBeforeWritten, 0u);
+				TestEqual(Name + TEXT(": fence values not increasing"), Result.FenceWentBack, 0u);
+				TestEqual(Name + TEXT(": deadlocks"), Result.Deadlocks, 0u);
+				TestTrue(Name + TEXT(": writer stays within the ring"), Result.MaxFramesAhead <= Depth);
+				MaxFramesAhead = FMath::Max(MaxFramesAhead, Result.MaxFramesAhead);
+			}
+			//a pipelined schedule that never lets the writer run ahead gains nothing over lock step
+			TestEqual(Name + TEXT(": writer gets the whole ring"), MaxFramesAhead, uint64(Depth));
+		}
+	}
+	return true;
+}
+
+#endif
@@ -26,6 +26,10 @@ namespace MzMetadataKeys
 		MZ_METADATA_KEY(PinHidden);
 		MZ_METADATA_KEY(PinnedCategories);
 		MZ_METADATA_KEY(NodeColor);
+		MZ_METADATA_KEY(TexturePipelineDepth);
+		MZ_METADATA_KEY(TextureRingHandles);
+		MZ_METADATA_KEY(InputReleaseSemaphore);
+		MZ_METADATA_KEY(OutputReleaseSemaphore);
 };
 
 inline FGuid StringToFGuid(FString string)
@@ -230,7 +234,7 @@ public:
 		}
 
 		
-		flatbuffers::FlatBufferBuilder mb;
+		FMZFlatBufferBuilder mb;
 
 		std::vector<std::string> NameList;
 		for (const auto& [name, _] : NameMap)
@@ -388,9 +392,31 @@ public:
 	//virtual flatbuffers::Offset<mz::fb::Pin> Serialize(flatbuffers::FlatBufferBuilder& fbb) override;
 	virtual void SetPropValue_Internal(void* val, size_t size, uint8* customContainer = nullptr) override;
 
+	//Remembers the track value that was just set so missing frames can be extrapolated from it
+	void RecordSample(uint32_t FrameNumber);
+	//Writes a constant velocity extrapolation of the last samples, returns false if prediction is off or not possible
+	bool PredictMissingSample();
+
 	FStructProperty* structprop;
+	uint64 PredictedFrames = 0;
 protected:
 	virtual void SetProperty_InCont(void* container, void* val) override;
+
+private:
+	struct TrackSample
+	{
+		uint32_t FrameNumber = 0;
+		FVector Location;
+		FVector Rotation;
+		double Fov = 0;
+		double FocusDistance = 0;
+	};
+
+	FMZTrack* GetTrackData();
+
+	TrackSample History[2];
+	uint32 HistoryCount = 0;
+	uint32 MissedFrames = 0;
 };
 
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+// Fence values UE and MediaZ wait for and signal around the texture copies of a frame.
+// This header has no engine or D3D dependencies so the schedules can be driven with simulated fences outside of Unreal.
+//
+// Each copy direction has a writer and a reader, UE writes the output pins and reads the input pins, MediaZ the opposite.
+// The writer fills the ring slot of a frame and signals, the reader waits for that, reads the slot and signals back.
+// Fences start at 0, so waiting for 0 never blocks.
+
+#include <cstdint>
+#include <memory>
+
+enum class EMZCopyDirection : uint8_t
+{
+	Input,
+	Output,
+};
+
+enum class EMZSyncFence : uint8_t
+{
+	//Exported with SetSyncSemaphores. Shared by both sides in lock step, only signaled by the writer when pipelined.
+	Input,
+	Output,
+	//Only used when pipelined, signaled by the reader once it is done with a slot
+	InputRelease,
+	OutputRelease,
+};
+
+struct FMZFenceOp
+{
+	EMZSyncFence Fence;
+	uint64_t Value;
+};
+
+class IMZFenceSchedule
+{
+public:
+	virtual ~IMZFenceSchedule() = default;
+
+	//Number of shared textures per pin, also the number of frames the writer may be ahead of the reader
+	virtual uint32_t GetDepth() const = 0;
+	uint32_t GetSlot(uint64_t Frame) const { return uint32_t(Frame % GetDepth()); }
+
+	//Before the writer fills the slot of Frame
+	virtual FMZFenceOp GetWriterWait(EMZCopyDirection Direction, uint64_t Frame) const = 0;
+	//After the writer filled the slot of Frame
+	virtual FMZFenceOp GetWriterSignal(EMZCopyDirection Direction, uint64_t Frame) const = 0;
+	//Before the reader reads the slot of Frame
+	virtual FMZFenceOp GetReaderWait(EMZCopyDirection Direction, uint64_t Frame) const = 0;
+	//After the reader is done with the slot of Frame
+	virtual FMZFenceOp GetReaderSignal(EMZCopyDirection Direction, uint64_t Frame) const = 0;
+
+	//UE writes the output pins and reads the input pins
+	FMZFenceOp GetLocalWait(EMZCopyDirection Direction, uint64_t Frame) const
+	{
+		return Direction == EMZCopyDirection::Output ? GetWriterWait(Direction, Frame) : GetReaderWait(Direction, Frame);
+	}
+	FMZFenceOp GetLocalSignal(EMZCopyDirection Direction, uint64_t Frame) const
+	{
+		return Direction == EMZCopyDirection::Output ? GetWriterSignal(Direction, Frame) : GetReaderSignal(Direction, Frame);
+	}
+	//What MediaZ signals once it is done with Frame
+	FMZFenceOp GetRemoteSignal(EMZCopyDirection Direction, uint64_t Frame) const
+	{
+		return Direction == EMZCopyDirection::Input ? GetWriterSignal(Direction, Frame) : GetReaderSignal(Direction, Frame);
+	}
+
+protected:
+	static EMZSyncFence GetFence(EMZCopyDirection Direction)
+	{
+		return Direction == EMZCopyDirection::Input ? EMZSyncFence::Input : EMZSyncFence::Output;
+	}
+	static EMZSyncFence GetReleaseFence(EMZCopyDirection Direction)
+	{
+		return Direction == EMZCopyDirection::Input ? EMZSyncFence::InputRelease : EMZSyncFence::OutputRelease;
+	}
+};
+
+// One texture per pin and one fence per direction, the writer and the reader take turns every frame:
+// writer waits 2N, signals 2N+1, reader waits 2N+1, signals 2N+2
+class FMZLockstepFenceSchedule : public IMZFenceSchedule
+{
+public:
+	uint32_t GetDepth() const override { return 1; }
+	FMZFenceOp GetWriterWait(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), 2 * Frame }; }
+	FMZFenceOp GetWriterSignal(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), 2 * Frame + 1 }; }
+	FMZFenceOp GetReaderWait(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), 2 * Frame + 1 }; }
+	FMZFenceOp GetReaderSignal(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), 2 * Frame + 2 }; }
+};
+
+// A ring of Depth textures per pin. The writer and the reader each signal their own fence with the number of frames
+// they are done with, so the writer can fill frame N+1 while the reader still reads frame N.
+// The writer only waits for the reader to release the slot it is about to overwrite.
+class FMZPipelinedFenceSchedule : public IMZFenceSchedule
+{
+public:
+	explicit FMZPipelinedFenceSchedule(uint32_t Depth) : Depth(Depth) {}
+
+	uint32_t GetDepth() const override { return Depth; }
+	FMZFenceOp GetWriterWait(EMZCopyDirection Direction, uint64_t Frame) const override
+	{
+		return { GetReleaseFence(Direction), Frame >= Depth ? Frame - Depth + 1 : 0 };
+	}
+	FMZFenceOp GetWriterSignal(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), Frame + 1 }; }
+	FMZFenceOp GetReaderWait(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetFence(Direction), Frame + 1 }; }
+	FMZFenceOp GetReaderSignal(EMZCopyDirection Direction, uint64_t Frame) const override { return { GetReleaseFence(Direction), Frame + 1 }; }
+
+private:
+	uint32_t const Depth;
+};
+
+inline std::unique_ptr<IMZFenceSchedule> MakeFenceSchedule(uint32_t Depth)
+{
+	if (Depth <= 1)
+	{
+		return std::make_unique<FMZLockstepFenceSchedule>();
+	}
+	return std::make_unique<FMZPipelinedFenceSchedule>(Depth);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright MediaZ AS. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <d3d12.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+// Shared render targets of the texture pins. Targets are reused across pins and resizes, so a steady state
+// neither creates resources nor flushes the render thread. A released target only becomes reusable once the GPU
+// passed a fence the pool signals after the commands that could still use it, and once MediaZ signaled its sync fences
+// of both directions for a frame started after the pin update that dropped the target was sent.
+// Game thread only.
+class MZSCENETREEMANAGER_API FMZRenderTargetPool
+{
+public:
+	struct FKey
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		ETextureRenderTargetFormat Format = RTF_RGBA16f;
+		//Image usage flags MediaZ sees the texture with
+		uint32 Flags = 0;
+
+		bool operator==(FKey const& Other) const = default;
+		friend uint32 GetTypeHash(FKey const& Key)
+		{
+			return HashCombine(HashCombine(GetTypeHash(Key.Width), GetTypeHash(Key.Height)), HashCombine(GetTypeHash((uint8)Key.Format), GetTypeHash(Key.Flags)));
+		}
+	};
+
+	void Initialize(ID3D12Device* Device, class MZTextureShareManager* Owner);
+
+	//Returns a free target of the key or creates one, OutHandle is the shared handle MediaZ opens the target with
+	UTextureRenderTarget2D* Acquire(FKey const& Key, FLinearColor const& ClearColor, FString const& DebugName, HANDLE& OutHandle);
+	//The target is reused once the GPU finished the commands enqueued so far and MediaZ confirmed it stopped using it
+	void Release(UTextureRenderTarget2D* Target);
+	//Makes targets whose fences completed reusable and destroys free targets over mediaz.RenderTargetPool.MaxFree.
+	//Called after the node updates of the frame were flushed.
+	void Tick();
+	//The sync fences were recreated and count from 0 again, released targets wait for frames on the new ones
+	void ResetConfirmFrames();
+
+	void DumpStats(FOutputDevice& Ar) const;
+
+private:
+	UTextureRenderTarget2D* Create(FKey const& Key, FLinearColor const& ClearColor, FString const& DebugName, HANDLE& OutHandle);
+	void Destroy(UTextureRenderTarget2D* Target);
+
+	struct FPooledTarget
+	{
+		FKey Key;
+		HANDLE Handle = 0;
+	};
+
+	struct FPendingRelease
+	{
+		UTextureRenderTarget2D* Target;
+		uint64 FenceValue;
+		//Frame MediaZ has to finish, set once the pin update that dropped the target was sent
+		TOptional<uint64> ConfirmFrame;
+	};
+	bool IsConfirmed(uint64 Frame) const;
+
+	ID3D12Device* Device = nullptr;
+	class MZTextureShareManager* Owner = nullptr;
+	ID3D12Fence* ReleaseFence = nullptr;
+	uint64 LastReleaseValue = 0;
+
+	TMap<UTextureRenderTarget2D*, FPooledTarget> Targets;
+	TMap<FKey, TArray<UTextureRenderTarget2D*>> FreeTargets;
+	int32 FreeCount = 0;
+	//In release order
+	TArray<FPendingRelease> PendingReleases;
+
+	uint64 Hits = 0;
+	uint64 Misses = 0;
+};
@@ -24,6 +24,8 @@ struct MZPortal
 	FString TypeName;
 	FString CategoryName;
 	mz::fb::ShowAs ShowAs;
+
+	PinQueueHandle QueueHandle;
 };
 
 //This class holds the list of all properties and pins 
@@ -42,6 +44,9 @@ public:
 	void CreatePortal(FProperty* uproperty, UObject* Container, mz::fb::ShowAs ShowAs);
 	void ActorDeleted(FGuid DeletedActorId);
 	flatbuffers::Offset<mz::fb::Pin> SerializePortal(flatbuffers::FlatBufferBuilder& fbb, MZPortal Portal, MZProperty* SourceProperty);
+	void RegisterPortalQueue(MZPortal& Portal, MZProperty* SourceProperty);
+	void UnregisterPortalQueue(MZPortal& Portal);
+	void UpdatePortalQueueOrdering(MZPortal const& Portal);
 	
 	FMZClient* MZClient;
 
@@ -220,6 +225,9 @@ public:
 	//Sends pin to add to a node
 	void SendPinAdded(FGuid NodeId, TSharedPtr<MZProperty> const& mzprop);
 
+	//Sends the root node pins of a texture property again after its shared texture ring was recreated
+	void SendRingHandlesChanged(MZProperty* MzProperty);
+
 	//Add to to-be-added actors list or send directly if always updating
 	void SendActorAddedOnUpdate(AActor* actor, FString spawnTag = FString());
 
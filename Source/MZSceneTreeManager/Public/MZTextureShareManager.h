@@ -18,6 +18,8 @@ void MemoryBarrier();
 #include <shared_mutex>
 
 #include "MZActorProperties.h"
+#include "MZFenceSchedule.h"
+#include "MZRenderTargetPool.h"
 #include "MediaZ/AppAPI.h" 
 #include <mzFlatBuffersCommon.h>
 #include "MZClient.h"
@@ -40,7 +42,29 @@ struct ResourceInfo
 	MZProperty* SrcMzp = 0;
 	UPROPERTY()
 	TObjectPtr<UTextureRenderTarget2D> DstResource = 0;
+	//Slots 1 to pipeline depth - 1 of the ring, slot 0 is DstResource
+	TArray<TObjectPtr<UTextureRenderTarget2D>> RingResources;
 	mz::fb::ShowAs ShowAs;
+
+	UTextureRenderTarget2D* GetSlotResource(uint32 Slot) const
+	{
+		return Slot == 0 ? DstResource.Get() : RingResources[Slot - 1].Get();
+	}
+};
+
+// Copies of one direction resolved to render target resources. Built on the game thread when pins are added or removed,
+// their show as changes or a render target of a pin changes, then read by the render thread as is every frame.
+struct FMZCopyPlan
+{
+	struct FCopy
+	{
+		//Render target of the property, the source of output copies and the destination of input copies
+		FTextureRenderTargetResource* Target = nullptr;
+		//Shared textures MediaZ sees, one per ring slot
+		TArray<FTextureRenderTargetResource*, TInlineAllocator<3>> Slots;
+		FIntVector Size;
+	};
+	TArray<FCopy> Copies;
 };
 
 enum CmdState
@@ -64,6 +88,9 @@ struct SyncSemaphoresExport
 {
 	HANDLE InputSemaphore;
 	HANDLE OutputSemaphore;
+	//Only created when the pipeline depth is above 1
+	HANDLE InputReleaseSemaphore = 0;
+	HANDLE OutputReleaseSemaphore = 0;
 };
 
 //This class manages copy operations between textures of MediaZ and unreal 2d texture target
@@ -85,7 +112,7 @@ public:
 	void Reset();
 	void TextureDestroyed(MZProperty* texture);
 	void SetupFences(FRHICommandListImmediate& RHICmdList, mz::fb::ShowAs CopyShowAs, TMap<ID3D12Fence*, u64>& SignalGroup, uint64_t frameNumber);
-	void ProcessCopies(mz::fb::ShowAs, TMap<MZProperty*, ResourceInfo>& CopyMap);
+	void ProcessCopies(mz::fb::ShowAs CopyShowAs);
 	void OnBeginFrame();
 	void OnEndFrame();
 	bool SwitchStateToSynced();
@@ -100,7 +127,11 @@ public:
 
 	TMap<FGuid, MZProperty*> PendingCopyQueue;
 
-	TQueue<TPair<TObjectPtr<UTextureRenderTarget2D>, uint32_t>> ResourcesToDelete;
+	//Called when the shared textures of a pipelined pin are recreated, the ring handles in its metadata changed
+	TFunction<void(MZProperty*)> OnRingHandlesChanged;
+
+	//Shared textures of the pins, released ones are reused once the GPU is done with them
+	FMZRenderTargetPool RenderTargetPool;
 	
 	TMap<MZProperty*, ResourceInfo> CopyOnTick;
 	UPROPERTY()
@@ -109,6 +140,15 @@ public:
 	uint64_t FrameCounter = 0;
 	ID3D12Fence* InputFence = nullptr;
 	ID3D12Fence* OutputFence= nullptr;
+	ID3D12Fence* InputReleaseFence = nullptr;
+	ID3D12Fence* OutputReleaseFence = nullptr;
+
+	//Fence values and ring slots of the copies, depth comes from mediaz.TexturePipelineDepth at startup
+	std::unique_ptr<IMZFenceSchedule> FenceSchedule;
+	uint32 GetPipelineDepth() const { return FenceSchedule->GetDepth(); }
+	ID3D12Fence* GetFence(EMZSyncFence Fence) const;
+	//Releases everything waiting on the sync fences, e.g. when MediaZ stops executing
+	void SignalAllFences(uint64_t Value);
 
 	mutable FCriticalSection CriticalSectionState;
 	
@@ -119,6 +159,29 @@ public:
 	void RenewSemaphores();
 private:
 bool CreateTextureResource(MZProperty*, mz::fb::TTexture& Texture, ResourceInfo& Resource);
+	//Returns the shared textures of the pin to the pool
+	void ReleaseTextureResource(ResourceInfo& Resource);
+	void ReleaseFence(ID3D12Fence*& Fence, HANDLE& Handle);
+
+	//Rebuilds the copy plans if pins changed or a render target of a pin is not the one the plans were built with
+	void UpdateCopyPlans();
+	bool AreCopyPlansValid() const;
+	void RebuildCopyPlans();
+
+	//What the plans were built from, compared every frame to notice render targets changing under the pins
+	struct FCopyPlanSource
+	{
+		MZProperty* Property = nullptr;
+		UTextureRenderTarget2D* Target = nullptr;
+		FTextureRenderTargetResource* Resource = nullptr;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+		ETextureRenderTargetFormat Format = RTF_RGBA16f;
+	};
+	TArray<FCopyPlanSource> CopyPlanSources;
+	TSharedPtr<FMZCopyPlan const, ESPMode::ThreadSafe> InputCopyPlan;
+	TSharedPtr<FMZCopyPlan const, ESPMode::ThreadSafe> OutputCopyPlan;
+	bool CopyPlansDirty = true;
 
 private:
 	void Initiate();